@@ -19,6 +19,7 @@ rec {
         , cmake
         , fmt_latest
         , openssl
+        , zlib
         }:
         let
           # Kept in sync with submodules, make sure to update this accordingly.
@@ -63,6 +64,7 @@ rec {
           buildInputs = [
             fmt_latest
             openssl
+            zlib
           ];
 
           cmakeFlags = [
@@ -0,0 +1,327 @@
+#include "backupstore.h"
+#include "savefile/savefile.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <fcntl.h>
+#include <fmt/chrono.h>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace {
+
+template <size_t Size> std::string ToHex(const std::array<u8, Size> &hash) {
+    return fmt::format("{:02x}", fmt::join(hash, ""));
+}
+
+template <size_t Size> std::array<u8, Size> FromHex(std::string_view hex) {
+    std::array<u8, Size> hash{};
+    if (hex.size() != hash.size() * 2)
+        throw exception("Invalid hash '{}'", hex);
+    for (size_t itr{}; itr < hash.size(); itr++) {
+        const auto begin{hex.data() + itr * 2};
+        const auto [end, error]{std::from_chars(begin, begin + 2, hash[itr], 16)};
+        if (error != std::errc{} || end != begin + 2)
+            throw exception("Invalid hash '{}'", hex);
+    }
+    return hash;
+}
+
+/**
+ * @brief Write to a temporary file and rename it over the target, so a file in the store is either complete or missing
+ */
+void WriteAtomically(const std::filesystem::path &path, std::span<const u8> data) {
+    // Threads of a batch may store the same chunk at the same time
+    std::filesystem::path temporaryPath{path};
+    temporaryPath += fmt::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+    std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw exception("Could not open file '{}'", util::ToAbsolutePath(temporaryPath).generic_string());
+
+    file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size_bytes()));
+    file.close();
+    if (!file)
+        throw exception("Could not write to file '{}'", util::ToAbsolutePath(temporaryPath).generic_string());
+
+    if (std::filesystem::exists(path))
+        std::filesystem::permissions(temporaryPath, std::filesystem::status(path).permissions());
+    std::filesystem::rename(temporaryPath, path);
+}
+
+/**
+ * @brief Create a file that did not exist yet, named prefix_counter_name with the lowest counter that is free
+ * @note The counter has a fixed width, so files with the same prefix and name sort in the order they were created
+ */
+std::filesystem::path WriteNewFile(const std::filesystem::path &directory, std::string_view prefix, std::string_view name, std::string_view contents) {
+    for (size_t attempt{};; attempt++) {
+        const auto path{directory / fmt::format("{}_{:04}_{}", prefix, attempt, name)};
+        const auto descriptor{open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644)};
+        if (descriptor == -1) {
+            if (errno == EEXIST)
+                continue;
+            throw exception("Could not create file '{}'", util::ToAbsolutePath(path).generic_string());
+        }
+
+        const auto written{::write(descriptor, contents.data(), contents.size())};
+        close(descriptor);
+        if (written != static_cast<ssize_t>(contents.size()))
+            throw exception("Could not write to file '{}'", util::ToAbsolutePath(path).generic_string());
+        return path;
+    }
+}
+
+} // namespace
+
+BackupStore::BackupStore(std::filesystem::path directory) : directory{std::move(directory)} {
+    std::filesystem::create_directories(this->directory / "chunks");
+    std::filesystem::create_directories(this->directory / "manifests");
+    std::filesystem::create_directories(this->directory / "hashes");
+}
+
+std::vector<BackupStore::ChunkRange> BackupStore::Chunks(size_t size) {
+    std::vector<ChunkRange> chunks;
+    if (size == SaveFileSize) {
+        const auto checksums{SaveFile::ChecksumSections()};
+        for (const auto &section : SaveFile::BackupChunks())
+            chunks.push_back({section, std::ranges::any_of(checksums, [&section](const Section &checksum) { return checksum.address == section.address; })});
+        return chunks;
+    }
+
+    for (size_t offset{}; offset < size; offset += FallbackChunkSize)
+        chunks.push_back({Section{offset, std::min(FallbackChunkSize, size - offset)}, false});
+    return chunks;
+}
+
+std::filesystem::path BackupStore::chunkPath(const util::Sha256Hash &hash) const {
+    const auto name{ToHex(hash)};
+    return directory / "chunks" / name.substr(0, 2) / name;
+}
+
+bool BackupStore::storeChunk(const util::Sha256Hash &hash, std::span<const u8> data) const {
+    const auto path{chunkPath(hash)};
+    if (std::filesystem::exists(path))
+        return false;
+
+    // Save data is mostly zeros, so even the default level shrinks chunks to a fraction of their size
+    uLongf size{compressBound(static_cast<uLong>(data.size()))};
+    std::vector<u8> compressed(size);
+    if (compress2(compressed.data(), &size, data.data(), static_cast<uLong>(data.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+        throw exception("Failed to compress a chunk of {} bytes", data.size());
+    compressed.resize(size);
+
+    std::filesystem::create_directories(path.parent_path());
+    WriteAtomically(path, compressed);
+    return true;
+}
+
+void BackupStore::loadChunk(const Chunk &chunk, std::span<u8> target) const {
+    const auto path{chunkPath(chunk.hash)};
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        throw exception("The chunk '{}' is missing from the backup store", util::ToAbsolutePath(path).generic_string());
+    const std::vector<u8> compressed{std::istreambuf_iterator<char>{file}, {}};
+
+    uLongf size{static_cast<uLongf>(target.size())};
+    if (uncompress(target.data(), &size, compressed.data(), static_cast<uLong>(compressed.size())) != Z_OK || size != target.size() || util::GenerateSha256(target) != chunk.hash)
+        throw exception("The chunk '{}' is corrupt", util::ToAbsolutePath(path).generic_string());
+}
+
+std::filesystem::path BackupStore::hashRecordPath(const std::filesystem::path &path) const {
+    const auto name{util::ToAbsolutePath(path).generic_string()};
+    return directory / "hashes" / ToHex(util::GenerateSha256(std::span{reinterpret_cast<const u8 *>(name.data()), name.size()}));
+}
+
+std::optional<BackupStore::HashRecord> BackupStore::readHashRecord(const std::filesystem::path &path) const {
+    // A missing or damaged record only means that every chunk is hashed again
+    std::ifstream file(hashRecordPath(path));
+    std::string line;
+    if (!std::getline(file, line) || line != HashRecordHeader)
+        return std::nullopt;
+
+    HashRecord record;
+    try {
+        while (std::getline(file, line)) {
+            std::istringstream stream{line};
+            std::string key, checksum, hash;
+            stream >> key;
+            if (key == "size")
+                stream >> record.size;
+            else if (key == "modified")
+                stream >> record.modified;
+            else if (key == "chunk" && stream >> checksum >> hash)
+                record.chunks.emplace_back(FromHex<util::Md5Hash{}.size()>(checksum), FromHex<util::Sha256Hash{}.size()>(hash));
+            else
+                return std::nullopt;
+            if (stream.fail())
+                return std::nullopt;
+        }
+    } catch (const std::exception &) {
+        return std::nullopt;
+    }
+    return record;
+}
+
+void BackupStore::writeHashRecord(const std::filesystem::path &path, const HashRecord &record) const {
+    auto contents{fmt::format("{}\nsize {}\nmodified {}\n", HashRecordHeader, record.size, record.modified)};
+    for (const auto &[checksum, hash] : record.chunks)
+        contents += fmt::format("chunk {} {}\n", ToHex(checksum), ToHex(hash));
+    WriteAtomically(hashRecordPath(path), std::span{reinterpret_cast<const u8 *>(contents.data()), contents.size()});
+}
+
+BackupStore::HashRecord BackupStore::storeFile(const std::filesystem::path &path, const std::optional<HashRecord> &previous, bool written) const {
+    HashRecord record{.size = std::filesystem::file_size(path), .modified = std::filesystem::last_write_time(path).time_since_epoch().count()};
+    const auto chunks{Chunks(record.size)};
+    record.chunks.resize(chunks.size());
+
+    // Another program might have changed a chunk without updating its checksum, so the record is only used if the file was not touched since, or if we wrote it
+    std::vector<size_t> changed;
+    if (previous && previous->size == record.size && previous->chunks.size() == chunks.size() && (written || previous->modified == record.modified)) {
+        // Only the checksums are read at first, a chunk still starting with the checksum it was recorded with holds the same data
+        std::vector<Section> checksums;
+        for (const auto &chunk : chunks)
+            if (chunk.checksummed)
+                checksums.emplace_back(chunk.section.address, util::Md5Hash{}.size());
+        util::FileBuffer file{path, checksums};
+
+        for (size_t index{}; index < chunks.size(); index++) {
+            auto &[checksum, hash]{record.chunks[index]};
+            if (chunks[index].checksummed)
+                std::ranges::copy(Section{chunks[index].section.address, checksum.size()}.bytesFrom(file.data()), checksum.begin());
+            const auto &[previousChecksum, previousHash]{previous->chunks[index]};
+            if ((chunks[index].checksummed ? checksum == previousChecksum : !written) && std::filesystem::exists(chunkPath(previousHash)))
+                hash = previousHash;
+            else
+                changed.push_back(index);
+        }
+    } else {
+        changed.resize(chunks.size());
+        std::iota(changed.begin(), changed.end(), 0);
+    }
+
+    std::vector<Section> sections;
+    for (const auto index : changed)
+        sections.push_back(chunks[index].section);
+    util::FileBuffer file{path, sections};
+    const auto data{file.data()};
+    if (data.size() != record.size)
+        throw exception("'{}' changed while it was backed up", util::ToAbsolutePath(path).generic_string());
+    Profiler::ScopedTimer timer{Profiler::Phase::Backup};
+
+    // Changed chunks are hashed, but only new chunks are compressed and written
+    std::atomic<size_t> storedBytes{};
+    util::ParallelFor(changed.size(), threads, [this, &chunks, &changed, &record, &storedBytes, data](size_t itr) {
+        const auto &chunk{chunks[changed[itr]]};
+        auto &[checksum, hash]{record.chunks[changed[itr]]};
+        const auto bytes{chunk.section.bytesFrom(data)};
+        if (chunk.checksummed)
+            std::copy_n(bytes.begin(), checksum.size(), checksum.begin());
+        hash = util::GenerateSha256(bytes);
+        if (storeChunk(hash, bytes))
+            storedBytes += bytes.size();
+    });
+    timer.addBytes(storedBytes);
+    return record;
+}
+
+std::filesystem::path BackupStore::backupFile(const std::filesystem::path &path, const HashRecord &record) const {
+    const auto now{fmt::localtime(std::chrono::system_clock::to_time_t(std::chrono::system_clock::now()))};
+    Manifest manifest{.source = util::ToAbsolutePath(path), .created = fmt::format("{:%Y-%m-%d %H:%M:%S}", now), .size = record.size};
+    const auto chunks{Chunks(record.size)};
+    for (size_t index{}; index < chunks.size(); index++)
+        manifest.chunks.push_back({chunks[index].section, record.chunks[index].second});
+
+    auto contents{fmt::format("{}\nsource {}\ncreated {}\nsize {}\n", ManifestHeader, manifest.source.generic_string(), manifest.created, manifest.size)};
+    for (const auto &[section, hash] : manifest.chunks)
+        contents += fmt::format("chunk 0x{:X} 0x{:X} {}\n", section.address, section.size, ToHex(hash));
+    return WriteNewFile(directory / "manifests", fmt::format("{:%Y-%m-%d_%H-%M-%S}", now), path.filename().string() + ".manifest", contents);
+}
+
+std::filesystem::path BackupStore::backup(const std::filesystem::path &saveFilePath) const {
+    const auto record{storeFile(saveFilePath, readHashRecord(saveFilePath))};
+    const auto manifest{backupFile(saveFilePath, record)};
+    writeHashRecord(saveFilePath, record);
+
+    std::filesystem::path bakFilePath{saveFilePath.string() + ".bak"};
+    if (std::filesystem::exists(bakFilePath)) {
+        backupFile(bakFilePath, storeFile(bakFilePath, std::nullopt));
+        std::filesystem::remove(bakFilePath); // If this differentiates from ER0000.sl2 the game will claim the savefile is corrupt
+    }
+    return manifest;
+}
+
+void BackupStore::recordWrite(const std::filesystem::path &path) const {
+    const auto previous{readHashRecord(path)};
+    if (previous)
+        writeHashRecord(path, storeFile(path, previous, true));
+}
+
+BackupStore::Manifest BackupStore::ReadManifest(const std::filesystem::path &path) {
+    const auto target{util::ToAbsolutePath(path).generic_string()};
+    std::ifstream file(path);
+    std::string line;
+    if (!std::getline(file, line) || line != ManifestHeader)
+        throw exception("'{}' is not a backup manifest", target);
+
+    Manifest manifest{.path = path};
+    for (size_t lineNumber{2}; std::getline(file, line); lineNumber++) {
+        std::istringstream stream{line};
+        std::string key, value;
+        stream >> key;
+        if (key == "source") {
+            std::getline(stream >> std::ws, value);
+            manifest.source = value;
+        } else if (key == "created") {
+            std::getline(stream >> std::ws, manifest.created);
+        } else if (key == "size") {
+            stream >> manifest.size;
+        } else if (key == "chunk") {
+            size_t address{}, size{};
+            stream >> std::hex >> address >> size >> value;
+            if (stream)
+                manifest.chunks.push_back({Section{address, size}, FromHex<util::Sha256Hash{}.size()>(value)});
+        } else {
+            throw exception("{}:{}: Unknown entry '{}'", target, lineNumber, key);
+        }
+        if (stream.fail())
+            throw exception("{}:{}: Invalid entry '{}'", target, lineNumber, line);
+    }
+
+    // Chunks have to cover the file without gaps, anything else means the manifest was modified
+    size_t covered{};
+    for (const auto &chunk : manifest.chunks) {
+        if (chunk.section.address != covered)
+            throw exception("'{}' does not cover 0x{:X} bytes at 0x{:X}", target, chunk.section.address - covered, covered);
+        covered = chunk.section.length;
+    }
+    if (covered != manifest.size)
+        throw exception("'{}' covers 0x{:X} of 0x{:X} bytes", target, covered, manifest.size);
+    return manifest;
+}
+
+std::vector<BackupStore::Manifest> BackupStore::manifests() const {
+    std::vector<std::filesystem::path> paths;
+    for (const auto &entry : std::filesystem::directory_iterator{directory / "manifests"})
+        if (entry.is_regular_file() && entry.path().extension() == ".manifest")
+            paths.push_back(entry.path());
+    // The names start with the time of the backup, followed by a counter for backups made within the same second
+    std::sort(paths.begin(), paths.end());
+
+    std::vector<Manifest> result;
+    for (const auto &path : paths)
+        result.push_back(ReadManifest(path));
+    return result;
+}
+
+void BackupStore::restore(const Manifest &manifest, const std::filesystem::path &target) const {
+    std::vector<u8> data(manifest.size);
+    util::ParallelFor(manifest.chunks.size(), threads, [this, &manifest, &data](size_t index) {
+        const auto &chunk{manifest.chunks[index]};
+        loadChunk(chunk, chunk.section.bytesFrom(data));
+    });
+    WriteAtomically(target, data);
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include "util.h"
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Deduplicated backups of save files, see --list-backups and --restore
+ * @note Files are split into chunks at the boundaries of their slots and save header, and every chunk is stored compressed under the SHA-256 of its contents.
+ * A backup is a small manifest listing the chunks of a file, so backing up a file only stores the chunks that changed since any earlier backup
+ */
+class BackupStore {
+  public:
+    struct Chunk {
+        Section section;         //!< The range of the file the chunk was taken from
+        util::Sha256Hash hash{}; //!< The hash of the uncompressed chunk, which is also its name in the store
+    };
+
+    struct Manifest {
+        std::filesystem::path path{};   //!< The manifest file itself
+        std::filesystem::path source{}; //!< The absolute path of the file that was backed up
+        std::string created{};          //!< The local time the backup was created
+        size_t size{};                  //!< The size of the file that was backed up
+        std::vector<Chunk> chunks{};    //!< Sorted by address, covering the whole file
+    };
+
+  private:
+    struct ChunkRange {
+        Section section;  //!< The range of the file
+        bool checksummed; //!< Whether the chunk starts with the MD5 sum of the rest of it, which the game updates whenever it changes the chunk
+    };
+
+    /**
+     * @brief The chunk hashes of a file as of its last backup or write, so the next backup only hashes the chunks that changed since
+     */
+    struct HashRecord {
+        size_t size{};                                                    //!< The size of the file when it was hashed
+        std::filesystem::file_time_type::rep modified{};                  //!< The modification time of the file when it was hashed
+        std::vector<std::pair<util::Md5Hash, util::Sha256Hash>> chunks{}; //!< The checksum every chunk starts with, zero if it has none, and the hash of the chunk
+    };
+
+    constexpr static std::string_view ManifestHeader{"erutils backup 1"};
+    constexpr static std::string_view HashRecordHeader{"erutils chunk hashes 1"};
+    constexpr static size_t FallbackChunkSize{1024 * 1024}; //!< Files that are not save files are split into chunks of this size
+
+    const std::filesystem::path directory;
+
+    /**
+     * @brief Split a file into chunks, save files are split at the boundaries of their slots and save header
+     */
+    static std::vector<ChunkRange> Chunks(size_t size);
+
+    std::filesystem::path chunkPath(const util::Sha256Hash &hash) const;
+
+    /**
+     * @brief Compress and store a chunk, unless a chunk with the same hash is already stored
+     * @return Whether the chunk was new
+     */
+    bool storeChunk(const util::Sha256Hash &hash, std::span<const u8> data) const;
+
+    /**
+     * @brief Read and decompress a chunk, checking it against its hash
+     */
+    void loadChunk(const Chunk &chunk, std::span<u8> target) const;
+
+    /**
+     * @brief The record of the chunk hashes of a file is named after the hash of its absolute path
+     */
+    std::filesystem::path hashRecordPath(const std::filesystem::path &path) const;
+
+    /**
+     * @return The recorded chunk hashes of a file, if there are any and they are readable
+     */
+    std::optional<HashRecord> readHashRecord(const std::filesystem::path &path) const;
+
+    void writeHashRecord(const std::filesystem::path &path, const HashRecord &record) const;
+
+    /**
+     * @brief Hash and store all chunks of a file that are not known yet
+     * @param previous The hashes recorded for the file, only used if the file was not modified since. A chunk that still starts with the recorded checksum is neither read nor hashed again,
+     * neither is a chunk without a checksum
+     * @param written Whether we wrote the file since it was recorded. Its checksums are all up to date, so the record is used regardless of the modification time, except for chunks without a checksum
+     * @return The hashes of the file as it is now
+     */
+    HashRecord storeFile(const std::filesystem::path &path, const std::optional<HashRecord> &previous, bool written = false) const;
+
+    /**
+     * @brief Store the chunks of a file and write its manifest
+     */
+    std::filesystem::path backupFile(const std::filesystem::path &path, const HashRecord &record) const;
+
+  public:
+    size_t threads{util::DefaultThreadCount()}; //!< The amount of threads used to hash and compress chunks
+
+    /**
+     * @param directory The root of the store, by default 'store' in the data directory
+     */
+    BackupStore(std::filesystem::path directory = util::CreateDataDirectory() / "store");
+
+    /**
+     * @brief Back up a save file along with its '.bak' file, which is removed afterwards as the game claims the save file is corrupt if the two differ
+     * @return The path of the manifest of the save file
+     */
+    std::filesystem::path backup(const std::filesystem::path &saveFilePath) const;
+
+    /**
+     * @brief Update the recorded chunk hashes of a file after writing to it, only the chunks whose checksum changed are hashed
+     * @note Files without recorded hashes, which have never been backed up, are left alone
+     */
+    void recordWrite(const std::filesystem::path &path) const;
+
+    /**
+     * @brief All backups in the store, oldest first
+     */
+    std::vector<Manifest> manifests() const;
+
+    static Manifest ReadManifest(const std::filesystem::path &path);
+
+    /**
+     * @brief Rebuild the file a manifest was created from, replacing the target atomically
+     */
+    void restore(const Manifest &manifest, const std::filesystem::path &target) const;
+};
@@ -0,0 +1,63 @@
+#include "batch.h"
+
+Batch::Batch(std::string_view pattern) : files{util::FindFiles(pattern, "ER0000.sl2")} {}
+
+Batch::Result Batch::process(const std::filesystem::path &path, const Operations &operations, const BackupStore *backups) const {
+    Result result{path};
+    try {
+        // Without any operations the file is only probed, which reads its size and first bytes
+        if (!operations.verify && !operations.steamId && !operations.setItem && !operations.script) {
+            if (!SaveFile::IsSaveFile(path))
+                throw exception("{} is not a valid Elden Ring save file.", util::ToAbsolutePath(path).generic_string());
+            return result;
+        }
+
+        // Without any changes to make the file is only streamed through, instead of being loaded
+        if (operations.verify && !operations.steamId && !operations.setItem && !operations.script) {
+            result.checksums = SaveFile::VerifyFile(path);
+            return result;
+        }
+
+        SaveFile saveFile{path};
+        saveFile.checksumThreads = 1; // Files are already processed in parallel
+        if (operations.verify)
+            result.checksums = saveFile.verifyChecksums();
+
+        if (operations.steamId)
+            saveFile.replaceSteamId(*operations.steamId);
+        if (operations.setItem) {
+            if (operations.slot >= saveFile.slots.size())
+                throw exception("Invalid slot index {}", operations.slot);
+            saveFile.setItem(operations.slot, saveFile.items[operations.setItem->first], operations.setItem->second);
+        }
+        if (operations.script)
+            operations.script->run(saveFile);
+
+        if (saveFile.modified() && !operations.dryRun) {
+            backups->backup(path);
+            saveFile.write(path);
+            backups->recordWrite(path);
+            result.written = true;
+        }
+    } catch (const std::exception &e) {
+        result.error = e.what();
+    }
+
+    return result;
+}
+
+std::vector<Batch::Result> Batch::run(const Operations &operations, size_t threads) const {
+    std::vector<Result> results(files.size());
+    // Save files of the same account share most of their chunks, so they are all backed up into one store
+    std::optional<BackupStore> backups;
+    if (!operations.dryRun && (operations.steamId || operations.setItem || operations.script)) {
+        backups.emplace();
+        backups->threads = 1; // Files are already processed in parallel
+    }
+
+    // Workers pick up the next file as soon as they are done, so a few slow files do not hold up the rest
+    util::ParallelFor(files.size(), threads, [this, &operations, &backups, &results](size_t index) {
+        results[index] = process(files[index], operations, backups ? &*backups : nullptr);
+    });
+    return results;
+}
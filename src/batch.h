@@ -0,0 +1,53 @@
+#pragma once
+#include "backupstore.h"
+#include "savefile/savefile.h"
+#include "script.h"
+#include "util.h"
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Applies the same set of operations to many save files, processing multiple files in parallel
+ */
+class Batch {
+  public:
+    struct Operations {
+        std::optional<u64> steamId{};                         //!< Replace the Steam ID embedded in every save file
+        std::optional<std::pair<std::string, u32>> setItem{}; //!< Set the quantity of an item in the given slot
+        size_t slot{};                                        //!< The slot to apply per-slot operations to
+        const Script *script{};                               //!< A script to run against every save file
+        bool verify{};                                        //!< Verify the stored checksums before applying any changes
+        bool dryRun{};                                        //!< Do not write any changes
+    };
+
+    struct Result {
+        std::filesystem::path path{};              //!< The save file this result belongs to
+        std::optional<ChecksumReport> checksums{}; //!< The checksums of the file as it was loaded, if they were verified
+        bool written{};                            //!< Whether any changes were written to the file
+        std::string error{};                       //!< Why processing the file failed, empty if it succeeded
+    };
+
+  private:
+    std::vector<std::filesystem::path> files; //!< All save files that are part of this batch
+
+    Result process(const std::filesystem::path &path, const Operations &operations, const BackupStore *backups) const;
+
+  public:
+    /**
+     * @param pattern A directory to search recursively for save files, or a glob pattern
+     */
+    Batch(std::string_view pattern);
+
+    /**
+     * @brief Apply the operations to every save file
+     * @param threads The amount of save files to process concurrently
+     * @return The result of every file, in the same order as the files were found. A failing file does not affect the others.
+     */
+    std::vector<Result> run(const Operations &operations, size_t threads) const;
+
+    size_t size() const {
+        return files.size();
+    }
+};
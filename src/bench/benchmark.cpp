@@ -0,0 +1,71 @@
+#include "benchmark.h"
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Benchmark {
+
+Runner::Runner(std::chrono::milliseconds minimumTime, std::string_view filter) : minimumTime{minimumTime}, filter{filter} {}
+
+std::chrono::nanoseconds Runner::measure(const std::function<void()> &operation, size_t iterations) const {
+    const auto start{std::chrono::steady_clock::now()};
+    for (size_t itr{}; itr < iterations; itr++)
+        operation();
+    return std::chrono::steady_clock::now() - start;
+}
+
+void Runner::run(std::string_view name, size_t bytesPerOp, const std::function<void()> &operation, bool quiet) {
+    if (name.find(filter) == std::string_view::npos)
+        return;
+
+    int savedStdout{-1};
+    if (quiet) {
+        std::fflush(stdout);
+        savedStdout = dup(STDOUT_FILENO);
+        const auto devNull{open("/dev/null", O_WRONLY)};
+        dup2(devNull, STDOUT_FILENO);
+        close(devNull);
+    }
+
+    measure(operation, 1); // Warm up caches and lazily built state
+    size_t iterations{1};
+    auto elapsed{measure(operation, iterations)};
+    while (elapsed < minimumTime) {
+        iterations *= 2;
+        elapsed = measure(operation, iterations);
+    }
+
+    if (quiet) {
+        std::fflush(stdout);
+        dup2(savedStdout, STDOUT_FILENO);
+        close(savedStdout);
+    }
+
+    Result result{std::string{name}, iterations, static_cast<double>(elapsed.count()) / static_cast<double>(iterations)};
+    if (bytesPerOp)
+        result.mbPerSecond = static_cast<double>(bytesPerOp) / result.nsPerOp * 1e9 / (1024 * 1024);
+    results.push_back(result);
+}
+
+void Runner::printTable() const {
+    size_t nameWidth{4};
+    for (const auto &result : results)
+        nameWidth = std::max(nameWidth, result.name.size());
+
+    fmt::print("{:<{}}  {:>12}  {:>16}  {:>12}\n", "name", nameWidth, "iterations", "ns/op", "MB/s");
+    for (const auto &result : results) {
+        const auto throughput{result.mbPerSecond ? fmt::format("{:.1f}", result.mbPerSecond) : "-"};
+        fmt::print("{:<{}}  {:>12}  {:>16.1f}  {:>12}\n", result.name, nameWidth, result.iterations, result.nsPerOp, throughput);
+    }
+}
+
+void Runner::printJson() const {
+    fmt::print("[\n");
+    for (size_t itr{}; itr < results.size(); itr++) {
+        const auto &result{results[itr]};
+        fmt::print("  {{\"name\": \"{}\", \"iterations\": {}, \"ns_per_op\": {:.1f}, \"mb_per_s\": {:.1f}}}{}\n", result.name, result.iterations, result.nsPerOp, result.mbPerSecond, itr + 1 < results.size() ? "," : "");
+    }
+    fmt::print("]\n");
+}
+
+} // namespace Benchmark
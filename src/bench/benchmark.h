@@ -0,0 +1,55 @@
+#pragma once
+#include "../util.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Benchmark {
+
+struct Result {
+    std::string name;     //!< The name of the benchmark
+    size_t iterations;    //!< The amount of times the operation ran in the measured batch
+    double nsPerOp;       //!< The average time of a single operation in nanoseconds
+    double mbPerSecond{}; //!< The throughput, 0 if the operation does not process a fixed amount of bytes
+};
+
+/**
+ * @brief Times operations by running them in batches that double in size until a batch takes long enough to measure
+ */
+class Runner {
+  private:
+    const std::chrono::nanoseconds minimumTime; //!< The minimum duration of the measured batch
+    const std::string filter;                   //!< Only benchmarks containing this in their name are run
+    std::vector<Result> results;
+
+    /**
+     * @brief Run the operation the given amount of times
+     * @return The duration of all iterations combined
+     */
+    std::chrono::nanoseconds measure(const std::function<void()> &operation, size_t iterations) const;
+
+  public:
+    Runner(std::chrono::milliseconds minimumTime, std::string_view filter = "");
+
+    /**
+     * @brief Run a benchmark and keep its result
+     * @param bytesPerOp The amount of bytes processed by a single operation, used to calculate the throughput
+     * @param quiet Send everything the operation prints to stdout to /dev/null
+     */
+    void run(std::string_view name, size_t bytesPerOp, const std::function<void()> &operation, bool quiet = false);
+
+    void printTable() const;
+
+    void printJson() const;
+};
+
+/**
+ * @brief Keep the compiler from optimizing away a value that is computed but never used
+ */
+template <typename T> void DoNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+} // namespace Benchmark
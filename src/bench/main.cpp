@@ -0,0 +1,154 @@
+#include "../arguments.h"
+#include "../md5.h"
+#include "../savefile/generator.h"
+#include "../savefile/replacer.h"
+#include "../savefile/savefile.h"
+#include "../savefile/scanner.h"
+#include "benchmark.h"
+#include <cstdlib>
+
+constexpr static size_t SlotSize{0x280000};
+
+/**
+ * @brief Benchmarks that need access to the private steps of SaveFile
+ */
+struct SaveFileBenchmarks {
+    static void Run(Benchmark::Runner &runner, const std::filesystem::path &savePath, const std::filesystem::path &workDirectory, size_t threads) {
+        // The file is mapped lazily, so this does not read all of it and has no meaningful throughput
+        runner.run("SaveFile::loadFile", 0, [&savePath]() {
+            SaveFile saveFile{savePath};
+            Benchmark::DoNotOptimize(saveFile.saveData[SaveFileSize - 1]);
+        });
+
+        SaveFile saveFile{savePath};
+        saveFile.checksumThreads = threads;
+        runner.run("SaveFile::parseSlots", 0, [&saveFile]() {
+            Benchmark::DoNotOptimize(saveFile.parseSlots());
+        });
+
+        runner.run("SaveFile::recalculateChecksums (all slots)", SaveFile::SaveHeaderSection.size + SaveFile::SlotCount * SlotSize, [&saveFile]() {
+            saveFile.staleHeaderChecksum = true;
+            saveFile.staleSlotChecksums.fill(true);
+            saveFile.recalculateChecksums(saveFile.saveData);
+        });
+
+        runner.run("SaveFile::verifyChecksums", SaveFile::SaveHeaderSection.size + SaveFile::SlotCount * SlotSize, [&saveFile]() {
+            Benchmark::DoNotOptimize(saveFile.verifyChecksums().valid());
+        });
+
+        // Streams the file from the page cache, so this is bound by hashing rather than the disk
+        runner.run("SaveFile::VerifyFile", SaveFileSize, [&savePath]() {
+            Benchmark::DoNotOptimize(SaveFile::VerifyFile(savePath).valid());
+        });
+
+        const auto item{saveFile.items.begin()};
+        const auto &slot{saveFile.slots.front()};
+        runner.run("Slot::getItemQuantity (cached index)", 0, [&saveFile, &slot, &item]() {
+            Benchmark::DoNotOptimize(slot.getItemQuantity(saveFile.saveData, *item));
+        });
+
+        runner.run("Slot::getItemQuantity (building the index)", SlotSize, [&saveFile, &slot, &item]() {
+            slot.invalidateInventory();
+            Benchmark::DoNotOptimize(slot.getItemQuantity(saveFile.saveData, *item));
+        });
+
+        runner.run(
+            "Slot::debugListItems", SlotSize, [&saveFile]() {
+                saveFile.debugListItems(0);
+            },
+            true);
+
+        const auto fullPath{workDirectory / "full.sl2"};
+        runner.run("SaveFile::write (new file)", SaveFileSize, [&saveFile, &fullPath, &item]() {
+            saveFile.setItem(0, *item, saveFile.getItem(0, *item) % 99 + 1);
+            saveFile.write(fullPath);
+        });
+
+        // Writing back to the source only has to write the modified ranges and one slot checksum
+        const auto inPlacePath{workDirectory / "in-place.sl2"};
+        std::filesystem::copy_file(savePath, inPlacePath, std::filesystem::copy_options::overwrite_existing);
+        SaveFile inPlace{inPlacePath};
+        runner.run("SaveFile::write (in place, one item)", 0, [&inPlace, &inPlacePath, &item]() {
+            inPlace.setItem(0, *item, inPlace.getItem(0, *item) % 99 + 1);
+            inPlace.write(inPlacePath);
+        });
+    }
+};
+
+int main(int argc, char **argv) {
+    CommandLineArguments::ArgumentParser arguments(argc, argv);
+    auto json{arguments.add<bool>({"--json", "Print the results as JSON"})};
+    auto filter{arguments.add<std::string_view>({"--filter", "<text>", "Only run benchmarks containing this text in their name"})};
+    auto minimumTime{arguments.add<size_t>({"--min-time", "<milliseconds>", "The minimum duration of each benchmark, by default 200"})};
+    auto threads{arguments.add<size_t>({"--threads", "<thread count>", "The amount of threads used to calculate checksums, by default the number of CPU cores"})};
+    auto items{arguments.add<size_t>({"--items", "<item count>", "The amount of inventory records in each slot of the generated savefile, by default 400"})};
+    auto help{arguments.add<bool>({"--help", "Print this help message"})};
+    arguments.check();
+
+    if (help.set) {
+        arguments.showUsage();
+        return 0;
+    }
+
+    std::string workTemplate{(std::filesystem::temp_directory_path() / "erutils-bench-XXXXXX").string()};
+    if (!mkdtemp(workTemplate.data()))
+        throw exception("Failed to create a temporary directory");
+    const std::filesystem::path workDirectory{workTemplate};
+    const auto savePath{workDirectory / "ER0000.sl2"};
+    SaveGenerator::Options options;
+    if (items.set)
+        options.itemsPerSlot = items.value;
+    SaveGenerator::Write(savePath, options);
+
+    Benchmark::Runner runner{std::chrono::milliseconds{minimumTime.set ? minimumTime.value : 200}, filter.value};
+    SaveFileBenchmarks::Run(runner, savePath, workDirectory, threads.set ? threads.value : util::DefaultThreadCount());
+
+    util::FileBuffer file{savePath};
+    std::vector<u8> saveData(file.data().begin(), file.data().end());
+    const auto slotData{std::span<u8>{saveData}.subspan(0x310, SlotSize)};
+    runner.run("util::GenerateMd5 (slot)", SlotSize, [&slotData]() {
+        Benchmark::DoNotOptimize(util::GenerateMd5(slotData));
+    });
+
+    // What a full checksum pass hashes: the save header and all slots, interleaved on a single thread
+    std::vector<std::span<const u8>> regions;
+    for (size_t slot{}; slot < 10; slot++)
+        regions.push_back(std::span<u8>{saveData}.subspan(0x310 + slot * (SlotSize + 0x10), SlotSize));
+    regions.push_back(std::span<u8>{saveData}.subspan(0x19003B0, 0x60000));
+    runner.run(fmt::format("util::GenerateMd5 (save file, {} lanes)", Md5::Lanes()), 10 * SlotSize + 0x60000, [&regions]() {
+        Benchmark::DoNotOptimize(util::GenerateMd5(regions));
+    });
+
+    runner.run("Scanner::FindDelimiters (slot)", SlotSize, [&slotData]() {
+        Benchmark::DoNotOptimize(Scanner::FindDelimiters(slotData));
+    });
+
+    // Like a rename, this searches the whole save for the name of a character
+    std::array<u8, Slot::NameSectionSize> name{};
+    std::copy_n(saveData.begin() + 0x1901D0E, name.size(), name.begin());
+    runner.run("util::ReplaceAll (save file)", SaveFileSize, [&saveData, &name]() {
+        Benchmark::DoNotOptimize(util::ReplaceAll<u8>(saveData, name, name));
+    });
+
+    // A copy replaces the Steam ID and a rename the name, the replacer handles both in one pass
+    std::array<u8, sizeof(u64)> steamId{};
+    std::copy_n(saveData.begin() + 0x19003B4, steamId.size(), steamId.begin());
+    runner.run("Replacer::apply (save file, 2 patterns)", SaveFileSize, [&saveData, &name, &steamId]() {
+        Benchmark::DoNotOptimize(Replacer{}.add(name, name).add(steamId, steamId).apply(saveData));
+    });
+
+    // Repeating a replacement after modifying a single slot only rescans that slot
+    OccurrenceIndex index;
+    Replacer{}.add(steamId, steamId).apply(saveData, &index);
+    runner.run("Replacer::apply (indexed, 1 dirty slot)", SlotSize, [&saveData, &steamId, &index]() {
+        index.invalidate(Section{0x310, SlotSize});
+        Benchmark::DoNotOptimize(Replacer{}.add(steamId, steamId).apply(saveData, &index));
+    });
+
+    if (json.set)
+        runner.printJson();
+    else
+        runner.printTable();
+
+    std::filesystem::remove_all(workDirectory);
+}
@@ -1,22 +1,38 @@
 #include "itemparser.h"
-#include "../util.h"
+#include "perfecthash.h"
+#include <algorithm>
 #include <array>
-#include <fmt/core.h>
-#include <sstream>
-
-const std::vector<std::string> ItemParser::parseLine(std::string_view line) const {
-    std::vector<std::string> result;
-    std::stringstream stream(line.data());
-    std::string item;
-    while (std::getline(stream, item, delimiter))
-        result.push_back(item);
-    return result;
+#include <charconv>
+#include <fmt/format.h>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <unordered_set>
+
+std::string_view ItemParser::nextLine() {
+    const auto end{contents.find('\n')};
+    auto line{contents.substr(0, end)};
+    contents.remove_prefix(end == std::string_view::npos ? contents.size() : end + 1);
+    if (line.ends_with('\r'))
+        line.remove_suffix(1);
+    return line;
+}
+
+void ItemParser::parseLine(std::string_view line, std::vector<std::string_view> &columns) const {
+    columns.clear();
+    for (size_t begin{};;) {
+        const auto end{line.find(delimiter, begin)};
+        columns.emplace_back(line.substr(begin, end - begin));
+        if (end == std::string_view::npos)
+            break;
+        begin = end + 1;
+    }
 }
 
-ItemParser::ItemParser(const std::string_view path) : file(path.data()) {
-    std::string firstLine;
-    std::getline(file, firstLine);
-    auto columns{parseLine(firstLine)};
+ItemParser::ItemParser(const std::filesystem::path &path) : file{path}, contents{reinterpret_cast<const char *>(file.data().data()), file.data().size()} {
+    std::vector<std::string_view> columns;
+    parseLine(nextLine(), columns);
     for (size_t itr{}; itr < columns.size(); itr++) {
         const auto column{columns.at(itr)};
         if (column == nameIdentifier.name)
@@ -29,9 +45,10 @@ ItemParser::ItemParser(const std::string_view path) : file(path.data()) {
 const std::string ItemParser::normalise(std::string_view string) const {
     constexpr std::array<unsigned char, 11> disallowed{'[', ']', '(', ')', '\'', '.', ',', '"', ':', '!', '&'};
     std::string result{};
+    result.reserve(string.size());
     for (std::string::size_type itr{}; itr < string.size(); itr++) {
         const auto character{string.at(itr)};
-        const auto previous{result.back()};
+        const auto previous{result.empty() ? '\0' : result.back()};
         if ((previous == '-' && character == '+') || (previous == '-' && character == ' ') || std::find(disallowed.begin(), disallowed.end(), character) != disallowed.end())
             continue;
         else if (character == ' ')
@@ -42,50 +59,250 @@ const std::string ItemParser::normalise(std::string_view string) const {
     return result;
 }
 
-void ItemParser::generate() {
-    std::vector<std::pair<std::string, std::string>> items;
-    std::string line;
+ItemParser::PerfectHashTable ItemParser::buildPerfectHash(const std::vector<std::string_view> &names) const {
+    constexpr static size_t KeysPerBucket{4};
+    if (names.size() > std::numeric_limits<u16>::max())
+        throw exception("Too many items for a 16 bit slot table: {}", names.size());
+
+    PerfectHashTable table{std::vector<u16>(std::max<size_t>(1, names.size() / KeysPerBucket)), std::vector<u16>(names.size())};
+    std::vector<std::vector<size_t>> buckets(table.seeds.size());
+    for (size_t itr{}; itr < names.size(); itr++)
+        buckets[PerfectHash::Bucket(names[itr], buckets.size())].push_back(itr);
+
+    // Place the largest buckets first, while most slots are still free
+    std::vector<size_t> order(buckets.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    std::vector<bool> used(names.size());
+    std::vector<size_t> positions;
+    for (const auto bucket : order) {
+        if (buckets[bucket].empty())
+            break;
+
+        for (u32 seed{1};; seed++) {
+            if (seed > std::numeric_limits<u16>::max())
+                throw exception("Could not find a perfect hash seed for bucket {}", bucket);
+
+            positions.clear();
+            for (const auto name : buckets[bucket]) {
+                const auto position{PerfectHash::Slot(names[name], seed, names.size())};
+                if (used[position] || std::find(positions.begin(), positions.end(), position) != positions.end())
+                    break;
+                positions.push_back(position);
+            }
+            if (positions.size() != buckets[bucket].size())
+                continue;
+
+            table.seeds[bucket] = static_cast<u16>(seed);
+            for (size_t itr{}; itr < positions.size(); itr++) {
+                used[positions[itr]] = true;
+                table.slots[positions[itr]] = static_cast<u16>(buckets[bucket][itr]);
+            }
+            break;
+        }
+    }
+    return table;
+}
+
+u16 ItemParser::parseId(const std::pair<std::string, std::string_view> &item) const {
+    u32 id{};
+    if (std::from_chars(item.second.data(), item.second.data() + item.second.size(), id).ec != std::errc{})
+        throw exception("Invalid item id '{}' for '{}'", item.second, item.first);
+    return static_cast<u16>(id);
+}
+
+ItemParser::IdTable ItemParser::buildIdTable(const std::vector<std::pair<std::string, std::string_view>> &items) const {
+    constexpr static size_t PageSize{0x100};
+    IdTable table{std::vector<u16>(PageSize), {}};
+    for (size_t itr{}; itr < items.size(); itr++) {
+        // Savefiles only store the lower 16 bits of an id, so the first item by name wins if those collide
+        const auto id{parseId(items[itr])};
+        auto &page{table.pages[id >> 8]};
+        if (!page) {
+            table.slots.resize(table.slots.size() + PageSize);
+            page = static_cast<u16>(table.slots.size() / PageSize);
+        }
+
+        auto &slot{table.slots[(page - 1) * PageSize + (id & 0xFF)]};
+        if (!slot)
+            slot = static_cast<u16>(itr + 1);
+    }
+    return table;
+}
+
+std::array<std::string, 0x100> ItemParser::buildGroupNames(const std::vector<std::pair<std::string, std::string_view>> &items) const {
+    // clang-format off
+    constexpr static std::array<std::pair<u8, std::string_view>, 6> knownGroups{{
+        {0xB, "Rune"},
+        {0x27, "SmithingStone"},
+        {0x4, "FowlFoot"},
+        {0x51, "CraftingMaterial"},
+        {0x2A, "Glovewort"},
+        {0x3B, "BeastBone"},
+    }};
+    // clang-format on
+
+    std::array<bool, 0x100> hasItems{};
+    std::array<std::map<std::string_view, size_t>, 0x100> wordCounts;
+    for (const auto &item : items) {
+        const auto group{parseId(item) >> 8};
+        hasItems[group] = true;
 
-    while (std::getline(file, line)) {
-        const auto columns{parseLine(line)};
-        if (columns.size() < std::max(nameIdentifier.index, idIdentifier.index))
+        const std::string_view name{item.first};
+        for (size_t begin{}; begin < name.size();) {
+            const auto end{std::min(name.find('-', begin), name.size())};
+            const auto word{name.substr(begin, end - begin)};
+            const auto numeric{std::all_of(word.begin(), word.end(), [](char character) {
+                return std::isdigit(character);
+            })};
+            if (!word.empty() && !numeric)
+                wordCounts[group][word]++;
+            begin = end + 1;
+        }
+    }
+
+    std::array<std::string, 0x100> names{};
+    for (size_t group{}; group < names.size(); group++) {
+        const auto &counts{wordCounts[group]};
+        if (!hasItems[group])
             continue;
-        const auto name{normalise(columns.at(nameIdentifier.index))};
-        const auto id{columns.at(idIdentifier.index)};
-        if (name.empty() || id.empty())
+        if (counts.empty()) {
+            names[group] = fmt::format("Group{:02X}", group);
             continue;
+        }
+
+        // Ties go to the word that sorts first, so the names do not depend on the order of the CSV
+        const auto common{std::max_element(counts.begin(), counts.end(), [](const auto &lhs, const auto &rhs) {
+            return lhs.second < rhs.second;
+        })};
+        names[group] = common->first;
+        names[group].front() = static_cast<char>(std::toupper(names[group].front()));
+    }
+
+    for (const auto &[group, name] : knownGroups)
+        names[group] = name;
+    return names;
+}
 
-        // clang-format off
-        if (std::find_if(items.begin(), items.end(), [name, id](const auto item) constexpr {
-            return item.first == name || item.second == id;
-        }) != items.end())
+std::string ItemParser::generate() {
+    std::vector<std::pair<std::string, std::string_view>> items;
+    std::unordered_set<std::string> seenNames;
+    std::unordered_set<std::string_view> seenIds;
+    std::vector<std::string_view> columns;
+
+    while (!contents.empty()) {
+        parseLine(nextLine(), columns);
+        if (columns.size() <= std::max(nameIdentifier.index, idIdentifier.index))
+            continue;
+        auto name{normalise(columns[nameIdentifier.index])};
+        const auto id{columns[idIdentifier.index]};
+        if (name.empty() || id.empty() || seenIds.contains(id) || !seenNames.insert(name).second)
             continue;
-        // clang-format on
-        items.push_back({normalise(columns.at(nameIdentifier.index)), columns.at(idIdentifier.index)});
+
+        seenIds.emplace(id);
+        items.emplace_back(std::move(name), id);
     }
     if (items.empty())
         throw exception("No items found while attempting to create generateditems.h");
 
-    fmt::print("#pragma once\n"
-               "#include <array>\n"
-               "#include <string_view>\n\n"
-               "namespace GeneratedItems {{\n\n"
-               "struct Item {{\n"
-               "    std::string_view name;\n"
-               "    std::int32_t id;\n"
-               "}};\n\n"
-               "constexpr static std::array<Item, {}> items{{{{\n",
-               items.size());
+    // Sorted by name, so the items can be listed in order without sorting them at runtime
+    std::sort(items.begin(), items.end());
+    std::vector<std::string_view> names;
+    for (const auto &item : items)
+        names.emplace_back(item.first);
+    const auto table{buildPerfectHash(names)};
+    const auto idTable{buildIdTable(items)};
+    const auto groupNames{buildGroupNames(items)};
+
+    fmt::memory_buffer output;
+    fmt::format_to(std::back_inserter(output), "#pragma once\n"
+                   "#include \"perfecthash.h\"\n"
+                   "#include <array>\n"
+                   "#include <cstdint>\n"
+                   "#include <string_view>\n\n"
+                   "namespace GeneratedItems {{\n\n"
+                   "struct Item {{\n"
+                   "    std::string_view name;\n"
+                   "    std::int32_t id;\n"
+                   "}};\n\n"
+                   "struct Group {{\n"
+                   "    std::string_view name;\n"
+                   "    bool known;\n"
+                   "}};\n\n"
+                   "constexpr static std::array<Item, {}> items{{{{\n",
+                   items.size());
     for (auto item : items)
-        fmt::print("    {{\"{}\", {}}},\n", item.first, item.second);
-    fmt::print("}}}};\n\n"
-               "}} // namespace GeneratedItems\n");
+        fmt::format_to(std::back_inserter(output), "    {{\"{}\", {}}},\n", item.first, item.second);
+    fmt::format_to(std::back_inserter(output), "}}}};\n\n");
+
+    constexpr static size_t ValuesPerLine{16};
+    const auto printTable{[&output](std::string_view name, const std::vector<u16> &values) {
+        fmt::format_to(std::back_inserter(output), "constexpr static std::array<std::uint16_t, {}> {}{{{{\n", values.size(), name);
+        for (size_t itr{}; itr < values.size(); itr += ValuesPerLine)
+            fmt::format_to(std::back_inserter(output), "    {},\n", fmt::join(values.begin() + itr, values.begin() + std::min(itr + ValuesPerLine, values.size()), ", "));
+        fmt::format_to(std::back_inserter(output), "}}}};\n\n");
+    }};
+    printTable("seeds", table.seeds);
+    printTable("slots", table.slots);
+    printTable("idPages", idTable.pages);
+    printTable("idSlots", idTable.slots);
+
+    fmt::format_to(std::back_inserter(output), "// Indexed by the upper 8 bits of an item id\n"
+                                               "constexpr static std::array<Group, {}> groups{{{{\n",
+                   groupNames.size());
+    for (const auto &name : groupNames)
+        fmt::format_to(std::back_inserter(output), "    {{\"{}\", {}}},\n", name, !name.empty());
+    fmt::format_to(std::back_inserter(output), "}}}};\n\n");
+
+    fmt::format_to(std::back_inserter(output), "/**\n"
+                   " * @brief Find an item by its normalised name in constant time\n"
+                   " * @return The item, or nullptr if no item has this name\n"
+                   " */\n"
+                   "constexpr const Item *Find(std::string_view name) {{\n"
+                   "    const auto &item{{items[slots[PerfectHash::Find(name, seeds, slots.size())]]}};\n"
+                   "    return item.name == name ? &item : nullptr;\n"
+                   "}}\n\n"
+                   "/**\n"
+                   " * @brief Find an item by the id and group stored in a savefile in constant time\n"
+                   " * @param id The id in the lower 8 bits, the group in the upper 8 bits\n"
+                   " * @return The item, or nullptr if no item has this id\n"
+                   " */\n"
+                   "constexpr const Item *FindId(std::uint16_t id) {{\n"
+                   "    const auto page{{idPages[id >> 8]}};\n"
+                   "    if (!page)\n"
+                   "        return nullptr;\n"
+                   "    const auto index{{idSlots[(page - 1) * 0x100 + (id & 0xFF)]}};\n"
+                   "    return index ? &items[index - 1] : nullptr;\n"
+                   "}}\n\n"
+                   "}} // namespace GeneratedItems\n");
+    return fmt::to_string(output);
 }
 
-int main() {
+int main(int argc, char **argv) {
     std::fstream versionFile{"external/erdb/latest_version.txt", std::ios::in};
     std::string version;
     std::getline(versionFile, version);
     ItemParser parser{fmt::format("external/erdb/gamedata/_Extracted/{}/EquipParamGoods.csv", version)};
-    parser.generate();
+    const auto generated{parser.generate()};
+    if (argc < 2) {
+        fmt::print("{}", generated);
+        return 0;
+    }
+
+    // Leave the header untouched if nothing changed, so everything including it does not have to be rebuilt
+    const std::filesystem::path outputPath{argv[1]};
+    if (std::filesystem::exists(outputPath)) {
+        std::ifstream existingFile{outputPath, std::ios::binary};
+        const std::string existing{std::istreambuf_iterator<char>{existingFile}, {}};
+        if (existing == generated)
+            return 0;
+    }
+
+    std::ofstream outputFile{outputPath, std::ios::binary | std::ios::trunc};
+    outputFile << generated;
+    if (!outputFile)
+        throw exception("Failed to write '{}'", outputPath.string());
 }
@@ -1,4 +1,6 @@
-#include <fstream>
+#include "../filebuffer.h"
+#include <array>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -15,13 +17,57 @@ class ItemParser {
     Identifier nameIdentifier{"Row Name"};
     Identifier idIdentifier{"Row ID"};
     constexpr static char delimiter{';'};
-    std::ifstream file;
+    util::FileBuffer file;
+    std::string_view contents; //!< The rows of the file after the header
 
-    const std::vector<std::string> parseLine(std::string_view line) const;
+    /**
+     * @brief Take the next line from the contents, without the line ending
+     */
+    std::string_view nextLine();
+
+    /**
+     * @brief Split a line into its columns
+     * @note The columns point into the line, no strings are copied
+     */
+    void parseLine(std::string_view line, std::vector<std::string_view> &columns) const;
     const std::string normalise(std::string_view string) const;
 
+    /**
+     * @brief The seeds and slot table of a minimal perfect hash over all names, see perfecthash.h
+     */
+    struct PerfectHashTable {
+        std::vector<u16> seeds; //!< The seed of every bucket
+        std::vector<u16> slots; //!< The index of the name that hashes to each slot
+    };
+
+    /**
+     * @brief Get the lower 16 bits of an item id, the part that is stored in a savefile
+     */
+    u16 parseId(const std::pair<std::string, std::string_view> &item) const;
+
+    PerfectHashTable buildPerfectHash(const std::vector<std::string_view> &names) const;
+
+    /**
+     * @brief A two level table from the 16 bit id stored in a savefile to the index of an item
+     */
+    struct IdTable {
+        std::vector<u16> pages; //!< The page of every group, 0 if there are no items in that group
+        std::vector<u16> slots; //!< 256 entries per page, each one the index of the item with that id plus 1, or 0 if there is none
+    };
+
+    IdTable buildIdTable(const std::vector<std::pair<std::string, std::string_view>> &items) const;
+
+    /**
+     * @brief Name every group that contains at least one item, groups without items are left empty
+     * @note Names are taken from a few well known groups, otherwise from the most common word in the names of the items in a group
+     */
+    std::array<std::string, 0x100> buildGroupNames(const std::vector<std::pair<std::string, std::string_view>> &items) const;
+
   public:
-    void generate();
+    /**
+     * @brief Create the contents of generateditems.h
+     */
+    std::string generate();
 
-    ItemParser(const std::string_view path);
+    ItemParser(const std::filesystem::path &path);
 };
@@ -0,0 +1,45 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief A minimal perfect hash over a fixed set of strings, shared by the code generator and the generated tables
+ * @note This uses hash and displace: every key is assigned to a bucket, and every bucket stores the seed that moves all of its keys into unused slots
+ */
+namespace PerfectHash {
+
+/**
+ * @brief FNV-1a followed by a murmur3 finalizer, so that different seeds give unrelated results
+ */
+constexpr std::uint32_t Hash(std::string_view string, std::uint32_t seed) {
+    std::uint32_t hash{0x811C9DC5 ^ seed};
+    for (const auto character : string) {
+        hash ^= static_cast<std::uint8_t>(character);
+        hash *= 0x01000193;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6B;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+constexpr std::size_t Bucket(std::string_view string, std::size_t bucketCount) {
+    return Hash(string, 0) % bucketCount;
+}
+
+constexpr std::size_t Slot(std::string_view string, std::uint32_t seed, std::size_t slotCount) {
+    return Hash(string, seed) % slotCount;
+}
+
+/**
+ * @brief Get the slot of a key, only meaningful if the key is part of the set the seeds were generated for
+ */
+template <std::size_t BucketCount> constexpr std::size_t Find(std::string_view string, const std::array<std::uint16_t, BucketCount> &seeds, std::size_t slotCount) {
+    return Slot(string, seeds[Bucket(string, BucketCount)], slotCount);
+}
+
+} // namespace PerfectHash
@@ -0,0 +1,119 @@
+#include "filebuffer.h"
+#include "profiler.h"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace util {
+
+FileBuffer::FileBuffer(const std::filesystem::path &path, bool map) {
+    Profiler::ScopedTimer timer{Profiler::Phase::Load};
+    if (!std::filesystem::exists(path))
+        throw exception("Path {} does not exist.", std::filesystem::absolute(path).generic_string());
+
+    const auto descriptor{open(path.c_str(), O_RDONLY)};
+    if (descriptor == -1)
+        throw exception("Could not open file '{}'", std::filesystem::absolute(path).generic_string());
+
+    struct stat status {};
+    if (map && fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+        mappingSize = static_cast<size_t>(status.st_size);
+        // A private mapping is copy-on-write, pages are only read from disk once they are accessed
+        auto address{mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0)};
+        if (address != MAP_FAILED)
+            mapping = static_cast<u8 *>(address);
+    }
+    close(descriptor);
+
+    if (!mapping)
+        read(path);
+    timer.addBytes(data().size_bytes());
+}
+
+FileBuffer::FileBuffer(const std::filesystem::path &path, std::vector<Section> sections) {
+    Profiler::ScopedTimer timer{Profiler::Phase::Load};
+    if (!std::filesystem::exists(path))
+        throw exception("Path {} does not exist.", std::filesystem::absolute(path).generic_string());
+
+    const auto descriptor{open(path.c_str(), O_RDONLY)};
+    if (descriptor == -1)
+        throw exception("Could not open file '{}'", std::filesystem::absolute(path).generic_string());
+
+    struct stat status {};
+    if (fstat(descriptor, &status) != 0 || !S_ISREG(status.st_mode)) {
+        close(descriptor);
+        throw exception("Could not open file '{}'", std::filesystem::absolute(path).generic_string());
+    }
+
+    const auto fileSize{static_cast<size_t>(status.st_size)};
+    if (fileSize > 0) {
+        auto address{mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)};
+        if (address != MAP_FAILED) {
+            mapping = static_cast<u8 *>(address);
+            mappingSize = fileSize;
+        } else {
+            buffer.resize(fileSize);
+        }
+    }
+
+    // Overlapping and adjacent ranges are read with a single call
+    std::sort(sections.begin(), sections.end(), [](const Section &a, const Section &b) {
+        return a.address < b.address;
+    });
+    std::vector<Section> merged;
+    for (const auto &section : sections) {
+        if (!merged.empty() && section.address <= merged.back().length)
+            merged.back() = Section{merged.back().address, std::max(merged.back().length, section.length) - merged.back().address};
+        else
+            merged.push_back(section);
+    }
+
+    const auto target{data()};
+    for (const auto &section : merged) {
+        // Ranges past the end of the file are left zeroed, the file is rejected once its size is validated
+        const auto end{std::min(section.length, fileSize)};
+        size_t offset{section.address};
+        while (offset < end) {
+            const auto count{pread(descriptor, target.data() + offset, end - offset, static_cast<off_t>(offset))};
+            if (count == -1 && errno == EINTR)
+                continue;
+            if (count <= 0) {
+                close(descriptor);
+                // The destructor does not run for a constructor that throws
+                if (mapping)
+                    munmap(mapping, mappingSize);
+                throw exception("Could not read {} bytes at 0x{:X} from '{}'", section.size, section.address, std::filesystem::absolute(path).generic_string());
+            }
+            offset += static_cast<size_t>(count);
+            timer.addBytes(static_cast<size_t>(count));
+        }
+    }
+    close(descriptor);
+}
+
+FileBuffer::~FileBuffer() {
+    if (mapping)
+        munmap(mapping, mappingSize);
+}
+
+void FileBuffer::read(const std::filesystem::path &path) {
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+        throw exception("Could not open file '{}'", std::filesystem::absolute(path).generic_string());
+
+    buffer.resize(std::filesystem::file_size(path));
+    file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+    buffer.resize(static_cast<size_t>(file.gcount()));
+}
+
+std::span<u8> FileBuffer::data() {
+    if (mapping)
+        return {mapping, mappingSize};
+    return buffer;
+}
+
+} // namespace util
@@ -0,0 +1,49 @@
+#pragma once
+#include "common.h"
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace util {
+
+/**
+ * @brief The contents of a file, privately memory mapped when possible and read into memory otherwise
+ * @note Modifications are copy-on-write and never reach the file itself
+ */
+class FileBuffer {
+  private:
+    std::vector<u8> buffer; //!< The contents of the file if it could not be mapped
+    u8 *mapping{};          //!< The start of the mapping, if the file is mapped
+    size_t mappingSize{};
+
+    void read(const std::filesystem::path &path);
+
+  public:
+    /**
+     * @param map Whether to map the file. Once another program truncates a mapped file, touching the pages past its new end kills the process with SIGBUS,
+     * and pages that were not modified yet show whatever it rewrote. Buffers that are kept for a long time should read the file instead
+     */
+    FileBuffer(const std::filesystem::path &path, bool map = true);
+
+    /**
+     * @brief Read only some ranges of a file with pread, every other byte reads as zero
+     * @note The rest of the buffer is anonymous memory, which is only allocated once it is written to
+     */
+    FileBuffer(const std::filesystem::path &path, std::vector<Section> sections);
+
+    FileBuffer(const FileBuffer &) = delete;
+    FileBuffer &operator=(const FileBuffer &) = delete;
+
+    ~FileBuffer();
+
+    std::span<u8> data();
+
+    /**
+     * @brief Whether the file is memory mapped rather than read into memory
+     */
+    bool mapped() const {
+        return mapping != nullptr;
+    }
+};
+
+} // namespace util
@@ -1,6 +1,12 @@
 #include "arguments.h"
+#include "backupstore.h"
+#include "batch.h"
+#include "profiler.h"
 #include "savefile/savefile.h"
+#include "script.h"
+#include "server.h"
 #include "util.h"
+#include "watcher.h"
 #include <fmt/format.h>
 #include <fstream>
 
@@ -8,6 +14,18 @@
 #define VERSION "0.0.1"
 #endif
 
+namespace {
+
+void PrintChecksumReport(const ChecksumReport &report) {
+    fmt::print("save header checksum: {}\n", report.headerValid ? "valid" : "corrupt");
+    for (const auto corruptSlot : report.corruptSlots)
+        fmt::print("slot {} checksum: corrupt\n", corruptSlot);
+    if (report.valid())
+        fmt::print("all checksums are valid\n");
+}
+
+} // namespace
+
 int main(int argc, char **argv) {
     CommandLineArguments::ArgumentParser arguments(argc, argv);
     auto savePath{util::FindFileInSubDirectory(fmt::format("{}/.steam/steam/steamapps/compatdata/1245620/pfx/drive_c/users/steamuser/AppData/Roaming/EldenRing", util::GetEnvironmentVariable("HOME")), "ER0000.sl2")};
@@ -24,9 +42,20 @@ int main(int argc, char **argv) {
     auto listAllItems{arguments.add<bool>({"--list-all-items", "List all the items that this program can edit"})};
     auto listItems{arguments.add<bool>({"--list-items", "List all items collected in the specified slot"})};
     auto setItem{arguments.add<std::pair<std::string_view, u32>>({"--set-item", "<item name> <amount>", "Change the amount of an item in the specified slot"})};
+    auto script{arguments.add<std::string_view>({"--script", "<file>", "Apply all operations listed in a file in a single pass, use '-' to read them from stdin"})};
     auto debugListItems{arguments.add<bool>({"--debug-list-items", "List all the items that are not yet implemented, useful for debugging"})};
     auto output{arguments.add<std::string_view>({"--output", "<savefile>", "Write the edited savefile to a new file"})};
+    auto verify{arguments.add<bool>({"--verify", "Check if the stored checksums match the data of the savefile"})};
+    auto batch{arguments.add<std::string_view>({"--batch", "<directory or glob>", "Apply --steam-id, --set-item, --script and --verify to every savefile found below a directory or matching a glob pattern"})};
+    auto serve{arguments.add<std::string_view>({"--serve", "<socket>", "Keep savefiles loaded and apply requests received over a Unix socket, see src/server.h for the protocol"})};
+    auto diff{arguments.add<std::pair<std::string_view, std::string_view>>({"--diff", "<savefile> <savefile>", "List the ranges in which the second savefile differs from the first, and write them as a patch to the file given with '--output'"})};
+    auto applyPatch{arguments.add<std::string_view>({"--apply-patch", "<patch>", "Apply a patch created with '--diff' to the savefile"})};
+    auto listBackups{arguments.add<bool>({"--list-backups", "List all backups that were made before writing to a savefile"})};
+    auto restore{arguments.add<std::string_view>({"--restore", "<manifest>", "Restore a backup listed by '--list-backups' to the file it was made of, or to the file given with '--output'"})};
+    auto watch{arguments.add<bool>({"--watch", "Keep running and print what changed in every slot whenever the game writes the savefile"})};
     auto dryRun{arguments.add<bool>({"--dry-run", "Do not write any changes to the savefile"})};
+    auto threads{arguments.add<size_t>({"--threads", "<thread count>", "The amount of threads used to calculate checksums, by default the number of CPU cores"})};
+    auto profile{arguments.add<std::string_view>({"--profile", "<table or json>", "Print the time spent and bytes processed in each phase to stderr when the program exits"})};
     auto version{arguments.add<bool>({"--version", "Print the version of the program"})};
     auto help{arguments.add<bool>({"--help", "Print this help message"})};
     arguments.check();
@@ -39,15 +68,148 @@ int main(int argc, char **argv) {
         return 0;
     }
 
+    if (profile.set) {
+        if (profile.value == "table")
+            Profiler::Enable(Profiler::Format::Table);
+        else if (profile.value == "json")
+            Profiler::Enable(Profiler::Format::Json);
+        else
+            throw exception("Unknown profile format '{}', expected 'table' or 'json'", profile.value);
+    }
+
     // TODO: default values in the argument parser
     if (!slot.set)
         slot.value = 0;
+
+    if (batch.set) {
+        for (const auto &[name, set] : std::initializer_list<std::pair<std::string_view, bool>>{{save.name, save.set}, {show.name, show.set}, {rename.name, rename.set}, {copy.name, copy.set}, {import.name, import.set}, {listAllItems.name, listAllItems.set}, {listItems.name, listItems.set}, {debugListItems.name, debugListItems.set}, {output.name, output.set}})
+            if (set)
+                throw exception("'{}' can not be used together with '--batch'", name);
+
+        std::optional<Script> batchScript;
+        if (script.set)
+            batchScript.emplace(Script::FromFile(script.value));
+
+        Batch::Operations operations{.slot = static_cast<size_t>(slot.value), .script = batchScript ? &*batchScript : nullptr, .verify = verify.set, .dryRun = dryRun.set};
+        if (steamId.set)
+            operations.steamId = steamId.value;
+        if (setItem.set)
+            operations.setItem = {std::string{setItem.value.first}, setItem.value.second};
+
+        const Batch files{batch.value};
+        const auto results{files.run(operations, threads.set ? threads.value : util::DefaultThreadCount())};
+        size_t failed{};
+        for (const auto &result : results) {
+            if (!result.error.empty()) {
+                failed++;
+                fmt::print("{}: failed: {}\n", result.path.generic_string(), result.error);
+                continue;
+            }
+
+            std::string status{result.written ? "written" : "unchanged"};
+            if (result.checksums) {
+                if (!result.checksums->headerValid)
+                    status += ", corrupt header";
+                if (!result.checksums->corruptSlots.empty())
+                    status += fmt::format(", corrupt slots: {}", fmt::join(result.checksums->corruptSlots, " "));
+                if (result.checksums->valid())
+                    status += ", checksums valid";
+            }
+            fmt::print("{}: {}\n", result.path.generic_string(), status);
+        }
+
+        fmt::print("\nprocessed {} savefiles, {} failed\n", results.size(), failed);
+        return failed ? 1 : 0;
+    }
+
+    if (serve.set) {
+        for (const auto &[name, set] : std::initializer_list<std::pair<std::string_view, bool>>{{save.name, save.set}, {steamId.name, steamId.set}, {show.name, show.set}, {rename.name, rename.set}, {copy.name, copy.set}, {import.name, import.set}, {listAllItems.name, listAllItems.set}, {listItems.name, listItems.set}, {setItem.name, setItem.set}, {script.name, script.set}, {debugListItems.name, debugListItems.set}, {output.name, output.set}, {verify.name, verify.set}, {dryRun.name, dryRun.set}, {applyPatch.name, applyPatch.set}})
+            if (set)
+                throw exception("'{}' can not be used together with '--serve'", name);
+
+        Server server{serve.value};
+        fmt::print("serving on '{}'\n", serve.value);
+        std::fflush(stdout); // Clients wait for this line before connecting
+        server.run();
+        return 0;
+    }
+
+    if (listBackups.set) {
+        const BackupStore backups;
+        for (const auto &manifest : backups.manifests())
+            fmt::print("{}: {}, {} bytes in {} chunks, made at {}\n", manifest.path.generic_string(), manifest.source.generic_string(), manifest.size, manifest.chunks.size(), manifest.created);
+        return 0;
+    }
+
+    if (restore.set) {
+        for (const auto &[name, set] : std::initializer_list<std::pair<std::string_view, bool>>{{save.name, save.set}, {steamId.name, steamId.set}, {show.name, show.set}, {rename.name, rename.set}, {copy.name, copy.set}, {import.name, import.set}, {listAllItems.name, listAllItems.set}, {listItems.name, listItems.set}, {setItem.name, setItem.set}, {script.name, script.set}, {debugListItems.name, debugListItems.set}, {verify.name, verify.set}, {applyPatch.name, applyPatch.set}, {watch.name, watch.set}, {diff.name, diff.set}})
+            if (set)
+                throw exception("'{}' can not be used together with '--restore'", name);
+
+        BackupStore backups;
+        if (threads.set)
+            backups.threads = threads.value;
+        const auto manifest{BackupStore::ReadManifest(restore.value)};
+        const auto target{output.set ? std::filesystem::path{output.value} : manifest.source};
+        fmt::print("restoring the backup of '{}' made at {} to '{}'\n", manifest.source.generic_string(), manifest.created, target.generic_string());
+        if (!dryRun.set) {
+            if (std::filesystem::exists(target))
+                fmt::print("wrote a backup of the replaced file, restore it with --restore '{}'\n", backups.backup(target).generic_string());
+            backups.restore(manifest, target);
+            fmt::print("succesfully restored '{}'\n", target.generic_string());
+        }
+        return 0;
+    }
+
+    if (diff.set) {
+        for (const auto &[name, set] : std::initializer_list<std::pair<std::string_view, bool>>{{save.name, save.set}, {steamId.name, steamId.set}, {show.name, show.set}, {rename.name, rename.set}, {copy.name, copy.set}, {import.name, import.set}, {listAllItems.name, listAllItems.set}, {listItems.name, listItems.set}, {setItem.name, setItem.set}, {script.name, script.set}, {debugListItems.name, debugListItems.set}, {verify.name, verify.set}, {applyPatch.name, applyPatch.set}, {watch.name, watch.set}})
+            if (set)
+                throw exception("'{}' can not be used together with '--diff'", name);
+
+        const SaveFile source{diff.value.first}, target{diff.value.second};
+        const auto patch{source.diff(target)};
+        fmt::print("comparing '{}' to '{}'\n\n", diff.value.first, diff.value.second);
+        for (const auto &change : patch)
+            fmt::print("0x{:07X}-0x{:07X} ({} bytes): {}\n", change.section.address, change.section.length, change.section.size, SaveFile::DescribeSection(change.section));
+        fmt::print("\n{} ranges differ, {} bytes in total. Checksums are not compared, they are recalculated when applying the patch\n", patch.size(), patch.changedBytes());
+
+        if (output.set && !dryRun.set) {
+            patch.write(output.value);
+            fmt::print("wrote the patch to '{}'\n", util::ToAbsolutePath(output.value).generic_string());
+        }
+        return 0;
+    }
+
     if (save.set)
         savePath.value = save.value;
     else if (!savePath.hasValue)
         throw exception(savePath.errorMessage);
 
-    SaveFile saveFile{savePath.value};
+    if (watch.set) {
+        for (const auto &[name, set] : std::initializer_list<std::pair<std::string_view, bool>>{{steamId.name, steamId.set}, {show.name, show.set}, {rename.name, rename.set}, {copy.name, copy.set}, {import.name, import.set}, {listAllItems.name, listAllItems.set}, {listItems.name, listItems.set}, {setItem.name, setItem.set}, {script.name, script.set}, {debugListItems.name, debugListItems.set}, {output.name, output.set}, {verify.name, verify.set}, {dryRun.name, dryRun.set}, {applyPatch.name, applyPatch.set}})
+            if (set)
+                throw exception("'{}' can not be used together with '--watch'", name);
+
+        fmt::print("watching savefile '{}'\n", savePath.value.string());
+        Watcher{savePath.value}.run();
+        return 0;
+    }
+
+    // Only verifying does not need the save loaded, the file is streamed instead and nothing is written
+    const auto modifiesSave{steamId.set || rename.set || copy.set || import.set || setItem.set || script.set || applyPatch.set};
+    if (verify.set && !modifiesSave && !show.set && !listItems.set && !listAllItems.set && !debugListItems.set && !output.set) {
+        fmt::print("using savefile '{}'\n", savePath.value.string());
+        PrintChecksumReport(SaveFile::VerifyFile(savePath.value));
+        return 0;
+    }
+
+    // Without changes, verification or an output file only the slot headers and the slot whose items are listed are read
+    auto sections{SaveFile::SummarySections()};
+    if (listItems.set || debugListItems.set)
+        std::ranges::copy(SaveFile::SlotSections(slot.value), std::back_inserter(sections));
+    SaveFile saveFile{modifiesSave || verify.set || output.set ? SaveFile{savePath.value} : SaveFile{savePath.value, sections}};
+    if (threads.set)
+        saveFile.checksumThreads = threads.value;
     fmt::print("using savefile '{}'\nSteam ID embedded in the savefile: {}\n", savePath.value.string(), saveFile.steamId());
 
     if (arguments.size() == 0) {
@@ -56,18 +218,34 @@ int main(int argc, char **argv) {
         exit(0);
     }
 
+    if (verify.set) {
+        PrintChecksumReport(saveFile.verifyChecksums());
+    }
+
     if (steamId.set) {
         saveFile.replaceSteamId(steamId.value);
         fmt::print("Steam ID set to {}\n", steamId.value);
     }
     fmt::print("\n");
 
+    if (script.set) {
+        auto operations{Script::FromFile(script.value)};
+        operations.run(saveFile);
+        fmt::print("applied {} operations from script '{}'\n\n", operations.size(), script.value);
+    }
+
+    if (applyPatch.set) {
+        const auto patch{Patch::FromFile(applyPatch.value)};
+        saveFile.applyPatch(patch);
+        fmt::print("applied {} ranges from patch '{}'\n\n", patch.size(), applyPatch.value);
+    }
+
     if (import.set) {
         if (!shownSlots) {
             saveFile.printSlot(slot.value);
             shownSlots = true;
         }
-        SaveFile importFile{import.value.first};
+        SaveFile importFile{import.value.first, SaveFile::SlotSections(import.value.second)};
         saveFile.copySlot(importFile, import.value.second, slot.value);
         fmt::print("imported slot {} from savefile '{}' into slot {}\n\n", import.value.second, import.value.first, slot.value);
     }
@@ -134,10 +312,13 @@ int main(int argc, char **argv) {
         saveFile.printActiveSlots();
 
     fmt::print("\n");
-    if (!dryRun.set) {
-        auto backupFile{util::BackupSavefile(savePath.value)};
+    // Only showing a save file leaves nothing to write, and it was only partially loaded
+    if (!dryRun.set && (modifiesSave || output.set)) {
+        BackupStore backups;
+        if (threads.set)
+            backups.threads = threads.value;
         // TODO: detect if the savefile has changed since it was loaded
-        fmt::print("wrote a backup of the original savefile to '{}'\n", util::ToAbsolutePath(backupFile).generic_string());
+        fmt::print("wrote a backup of the original savefile, restore it with --restore '{}'\n", backups.backup(savePath.value).generic_string());
         if (output.set) {
             outputPath = output.value;
             if (std::filesystem::exists(outputPath))
@@ -145,6 +326,7 @@ int main(int argc, char **argv) {
         } else
             outputPath = savePath.value;
         saveFile.write(outputPath);
+        backups.recordWrite(outputPath);
         fmt::print("succesfully wrote changes to '{}'\n", outputPath.generic_string());
     }
 }
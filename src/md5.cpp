@@ -0,0 +1,322 @@
+#include "md5.h"
+#include <array>
+#include <cstring>
+#include <optional>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MD5_X86
+#endif
+
+namespace Md5 {
+
+namespace {
+
+constexpr size_t BlockSize{64};
+
+// clang-format off
+constexpr std::array<u32, 64> Constants{
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+constexpr std::array<u32, 64> Shifts{
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20, 5,  9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
+// clang-format on
+
+constexpr State InitialState{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+/**
+ * @brief The message word used by every step
+ */
+constexpr u32 WordIndex(size_t step) {
+    if (step < 16)
+        return static_cast<u32>(step);
+    if (step < 32)
+        return static_cast<u32>((5 * step + 1) % 16);
+    if (step < 48)
+        return static_cast<u32>((3 * step + 5) % 16);
+    return static_cast<u32>((7 * step) % 16);
+}
+
+/**
+ * @brief A piece of a stream to hash, along with the state of the stream before it
+ */
+struct Job {
+    std::span<const u8> input;
+    State state{}; //!< Receives the state after the input is hashed
+    u64 length{};  //!< The length of the whole stream, only used for the padding
+    bool finish{}; //!< Whether this is the last piece of the stream, which gets padded. Otherwise its size must be a multiple of the block size
+};
+
+/**
+ * @brief The job assigned to a lane, and where it is in hashing it
+ */
+struct Stream {
+    Job *job;
+    size_t block{};       //!< The next block to hash
+    size_t fullBlocks{};  //!< The amount of blocks that can be read from the input directly
+    size_t totalBlocks{}; //!< Including the blocks holding the padding and length
+    std::array<u8, 2 * BlockSize> tail{};
+
+    Stream(Job &job) : job{&job}, fullBlocks{job.input.size() / BlockSize}, totalBlocks{fullBlocks} {
+        if (!job.finish)
+            return;
+
+        // The remaining bytes are followed by a one bit, zeros and the length in bits, which may not fit in the same block
+        const auto remaining{job.input.size() % BlockSize};
+        const auto tailBlocks{remaining + 1 + sizeof(u64) <= BlockSize ? 1 : 2};
+        totalBlocks += tailBlocks;
+        std::memcpy(tail.data(), job.input.data() + fullBlocks * BlockSize, remaining);
+        tail[remaining] = 0x80;
+        const u64 bits{job.length * 8};
+        std::memcpy(tail.data() + tailBlocks * BlockSize - sizeof(u64), &bits, sizeof(u64));
+    }
+
+    const u8 *nextBlock() const {
+        return block < fullBlocks ? job->input.data() + block * BlockSize : tail.data() + (block - fullBlocks) * BlockSize;
+    }
+};
+
+/**
+ * @brief A vector of 32 bit lanes, the size of a vector attribute can not depend on a template parameter
+ */
+template <size_t Lanes> struct LaneVector;
+template <> struct LaneVector<4> {
+    typedef u32 Type __attribute__((vector_size(16)));
+};
+template <> struct LaneVector<8> {
+    typedef u32 Type __attribute__((vector_size(32)));
+};
+template <> struct LaneVector<16> {
+    typedef u32 Type __attribute__((vector_size(64)));
+};
+
+/**
+ * @brief Run all jobs, each lane of the vectors holds the state of a separate stream
+ * @note Always inlined into the kernels below, so the vector operations are compiled for the instruction set of each kernel
+ */
+template <size_t Lanes> [[gnu::always_inline]] inline void HashLanes(std::span<Job> jobs) {
+    // Arrays of these are plain C arrays, std::array would drop the vector attribute
+    using Vector = typename LaneVector<Lanes>::Type;
+
+    std::array<std::optional<Stream>, Lanes> streams{};
+    Vector state[4]{};
+    size_t nextJob{};
+    alignas(64) std::array<std::array<u32, Lanes>, 16> words{};
+
+    while (true) {
+        // Refill idle lanes as soon as possible, so inputs of different sizes do not leave them idle until the end
+        bool active{};
+        for (size_t lane{}; lane < Lanes; lane++) {
+            // Jobs without any blocks leave their state as is
+            while (!streams[lane] && nextJob < jobs.size()) {
+                if (Stream stream{jobs[nextJob++]}; stream.totalBlocks) {
+                    for (size_t word{}; word < stream.job->state.size(); word++)
+                        state[word][lane] = stream.job->state[word];
+                    streams[lane].emplace(stream);
+                }
+            }
+            active |= streams[lane].has_value();
+        }
+        if (!active)
+            break;
+
+        // Transpose the next block of every stream, so word i of all lanes is in one vector. Idle lanes hash zeros
+        for (size_t lane{}; lane < Lanes; lane++) {
+            if (!streams[lane])
+                continue;
+            const auto block{streams[lane]->nextBlock()};
+            for (size_t word{}; word < words.size(); word++)
+                std::memcpy(&words[word][lane], block + word * sizeof(u32), sizeof(u32));
+        }
+        Vector message[16];
+        for (size_t word{}; word < words.size(); word++)
+            std::memcpy(&message[word], words[word].data(), sizeof(Vector));
+
+        auto a{state[0]}, b{state[1]}, c{state[2]}, d{state[3]};
+#pragma GCC unroll 64
+        for (size_t step{}; step < 64; step++) {
+            Vector function;
+            if (step < 16)
+                function = d ^ (b & (c ^ d));
+            else if (step < 32)
+                function = c ^ (d & (b ^ c));
+            else if (step < 48)
+                function = b ^ c ^ d;
+            else
+                function = c ^ (b | ~d);
+
+            const Vector sum{a + function + Constants[step] + message[WordIndex(step)]};
+            a = d;
+            d = c;
+            c = b;
+            b = b + ((sum << Shifts[step]) | (sum >> (32 - Shifts[step])));
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+
+        for (size_t lane{}; lane < Lanes; lane++) {
+            if (!streams[lane] || ++streams[lane]->block < streams[lane]->totalBlocks)
+                continue;
+            for (size_t word{}; word < InitialState.size(); word++)
+                streams[lane]->job->state[word] = state[word][lane];
+            streams[lane].reset();
+        }
+    }
+}
+
+using Kernel = void (*)(std::span<Job>);
+
+#ifdef MD5_X86
+__attribute__((target("sse2"))) void HashSse2(std::span<Job> jobs) {
+    HashLanes<4>(jobs);
+}
+
+__attribute__((target("avx2"))) void HashAvx2(std::span<Job> jobs) {
+    HashLanes<8>(jobs);
+}
+
+__attribute__((target("avx512f"))) void HashAvx512(std::span<Job> jobs) {
+    HashLanes<16>(jobs);
+}
+#endif
+
+struct Selected {
+    std::string_view name;
+    Kernel kernel{};
+    size_t lanes{};
+};
+
+/**
+ * @brief All kernels this CPU supports, fastest first. The last one has no kernel, every stream is hashed on its own with OpenSSL
+ */
+std::vector<Selected> Supported() {
+    std::vector<Selected> kernels;
+#ifdef MD5_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        kernels.push_back({"avx512f", HashAvx512, 16});
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", HashAvx2, 8});
+    if (__builtin_cpu_supports("sse2"))
+        kernels.push_back({"sse2", HashSse2, 4});
+#endif
+    kernels.push_back({"openssl"});
+    return kernels;
+}
+
+/**
+ * @brief The kernel in use, selected once based on the features of the CPU we are running on
+ */
+Selected &Selection() {
+    static auto selected{Supported().front()};
+    return selected;
+}
+
+/**
+ * @brief Get the hash from the state after the padding, which is the state in little endian
+ */
+util::Md5Hash ToHash(const State &state) {
+    util::Md5Hash hash;
+    std::memcpy(hash.data(), state.data(), hash.size());
+    return hash;
+}
+
+} // namespace
+
+size_t Lanes() {
+    return Selection().lanes;
+}
+
+std::vector<std::string_view> SupportedKernels() {
+    std::vector<std::string_view> names;
+    for (const auto &kernel : Supported())
+        names.push_back(kernel.name);
+    return names;
+}
+
+void UseKernel(std::string_view name) {
+    for (const auto &kernel : Supported())
+        if (kernel.name == name) {
+            Selection() = kernel;
+            return;
+        }
+    throw exception("The MD5 kernel '{}' is not supported by this CPU", name);
+}
+
+void HashMultiBuffer(const std::vector<std::span<const u8>> &inputs, std::span<util::Md5Hash> hashes) {
+    if (hashes.size() < inputs.size())
+        throw exception("Can not store {} hashes in {} entries", inputs.size(), hashes.size());
+    if (!Selection().kernel)
+        throw exception("There is no multi-buffer MD5 kernel for this CPU");
+
+    std::vector<Job> jobs;
+    for (const auto input : inputs)
+        jobs.push_back({input, InitialState, input.size(), true});
+    Selection().kernel(jobs);
+    for (size_t itr{}; itr < jobs.size(); itr++)
+        hashes[itr] = ToHash(jobs[itr].state);
+}
+
+Streams::Streams(size_t count) : states(count, InitialState), lengths(count) {
+    if (!Selection().kernel)
+        for (size_t itr{}; itr < count; itr++)
+            fallback.emplace_back();
+}
+
+void Streams::update(const std::vector<std::span<const u8>> &pieces) {
+    if (pieces.size() != states.size())
+        throw exception("Expected a piece for each of the {} streams, got {}", states.size(), pieces.size());
+
+    size_t bytes{};
+    for (const auto piece : pieces)
+        bytes += piece.size();
+    if (!fallback.empty()) {
+        for (size_t itr{}; itr < pieces.size(); itr++)
+            fallback[itr].update(pieces[itr]);
+        return;
+    }
+
+    Profiler::ScopedTimer timer{Profiler::Phase::Md5, bytes};
+    std::vector<Job> jobs;
+    for (size_t itr{}; itr < pieces.size(); itr++) {
+        if (pieces[itr].size() % BlockSize)
+            throw exception("The size of a piece must be a multiple of {} bytes, got {}", BlockSize, pieces[itr].size());
+        jobs.push_back({pieces[itr], states[itr]});
+        lengths[itr] += pieces[itr].size();
+    }
+    Selection().kernel(jobs);
+    for (size_t itr{}; itr < jobs.size(); itr++)
+        states[itr] = jobs[itr].state;
+}
+
+std::vector<util::Md5Hash> Streams::finish() {
+    std::vector<util::Md5Hash> hashes;
+    if (!fallback.empty()) {
+        for (auto &context : fallback)
+            hashes.push_back(context.finish());
+        return hashes;
+    }
+
+    std::vector<Job> jobs;
+    for (size_t itr{}; itr < states.size(); itr++)
+        jobs.push_back({{}, states[itr], lengths[itr], true});
+    Selection().kernel(jobs);
+    for (const auto &job : jobs)
+        hashes.push_back(ToHash(job.state));
+    return hashes;
+}
+
+} // namespace Md5
@@ -0,0 +1,64 @@
+#pragma once
+#include "util.h"
+#include <array>
+#include <span>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Multi-buffer MD5, hashes independent inputs in the lanes of vector registers
+ * @note MD5 is serial within a stream, so this only helps when several regions have to be hashed, like the save header and slots
+ */
+namespace Md5 {
+
+/**
+ * @brief The amount of streams the fastest kernel supported by this CPU hashes at once, 0 if there is no multi-buffer kernel
+ */
+size_t Lanes();
+
+/**
+ * @brief The names of all kernels this CPU supports, fastest first. The last one is 'openssl', which hashes every stream on its own
+ */
+std::vector<std::string_view> SupportedKernels();
+
+/**
+ * @brief Use the named kernel instead of the fastest one, so every kernel can be tested on the same CPU
+ * @note Not thread safe, only call this before hashing
+ */
+void UseKernel(std::string_view name);
+
+/**
+ * @brief Hash every input as a separate stream, the results match hashing them one at a time
+ * @param hashes Receives the hash of every input, must be as large as inputs
+ * @note Lanes are refilled as soon as their input is done, so inputs of different sizes do not leave lanes idle
+ */
+void HashMultiBuffer(const std::vector<std::span<const u8>> &inputs, std::span<util::Md5Hash> hashes);
+
+using State = std::array<u32, 4>; //!< The four state words of a stream
+
+/**
+ * @brief Hashes several streams whose data arrives in pieces, the pieces of all streams are interleaved like HashMultiBuffer
+ * @note On CPUs without a multi-buffer kernel every stream is hashed on its own with OpenSSL
+ */
+class Streams {
+  private:
+    std::vector<State> states;
+    std::vector<u64> lengths;               //!< The amount of bytes hashed per stream, which is part of the padding
+    std::vector<util::Md5Context> fallback; //!< Used instead of the states if there is no multi-buffer kernel
+
+  public:
+    explicit Streams(size_t count);
+
+    /**
+     * @brief Hash the next piece of every stream
+     * @param pieces One piece per stream, which may be empty. The size of each must be a multiple of 64 bytes
+     */
+    void update(const std::vector<std::span<const u8>> &pieces);
+
+    /**
+     * @brief Get the hash of every stream, after which no more pieces can be added
+     */
+    std::vector<util::Md5Hash> finish();
+};
+
+} // namespace Md5
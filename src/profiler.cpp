@@ -0,0 +1,51 @@
+#include "profiler.h"
+#include <cstdlib>
+#include <fmt/format.h>
+
+namespace Profiler {
+
+namespace {
+
+constexpr std::array<std::string_view, static_cast<size_t>(Phase::Count)> PhaseNames{"load", "validate", "parse slots", "item scan", "replace all", "md5", "diff", "backup", "write"};
+
+double Milliseconds(std::uint64_t nanoseconds) {
+    return static_cast<double>(nanoseconds) / 1e6;
+}
+
+double MegabytesPerSecond(std::uint64_t bytes, std::uint64_t nanoseconds) {
+    return nanoseconds ? static_cast<double>(bytes) / (1024 * 1024) / (static_cast<double>(nanoseconds) / 1e9) : 0;
+}
+
+} // namespace
+
+void Enable(Format format) {
+    detail::enabled = true;
+    detail::format = format;
+    std::atexit([]() {
+        Print(detail::format);
+    });
+}
+
+void Print(Format format) {
+    if (format == Format::Json) {
+        fmt::print(stderr, "{{\n  \"phases\": [\n");
+        for (size_t itr{}; itr < detail::phases.size(); itr++) {
+            const auto &counter{detail::phases[itr]};
+            fmt::print(stderr, "    {{\"name\": \"{}\", \"calls\": {}, \"ms\": {:.3f}, \"bytes\": {}, \"mb_per_s\": {:.1f}}}{}\n", PhaseNames[itr], counter.calls.load(), Milliseconds(counter.nanoseconds), counter.bytes.load(), MegabytesPerSecond(counter.bytes, counter.nanoseconds), itr + 1 < detail::phases.size() ? "," : "");
+        }
+        fmt::print(stderr, "  ],\n  \"searches\": {{\"calls\": {}, \"bytes\": {}}}\n}}\n", detail::searches.calls.load(), detail::searches.bytes.load());
+        return;
+    }
+
+    fmt::print(stderr, "\n{:<12}  {:>8}  {:>12}  {:>14}  {:>10}\n", "phase", "calls", "time (ms)", "bytes", "MB/s");
+    for (size_t itr{}; itr < detail::phases.size(); itr++) {
+        const auto &counter{detail::phases[itr]};
+        if (!counter.calls)
+            continue;
+        fmt::print(stderr, "{:<12}  {:>8}  {:>12.3f}  {:>14}  {:>10.1f}\n", PhaseNames[itr], counter.calls.load(), Milliseconds(counter.nanoseconds), counter.bytes.load(), MegabytesPerSecond(counter.bytes, counter.nanoseconds));
+    }
+    fmt::print(stderr, "\npattern searches: {}, bytes scanned: {}\n", detail::searches.calls.load(), detail::searches.bytes.load());
+    fmt::print(stderr, "time is summed over all threads, so parallel phases can exceed the wall time of the run\n");
+}
+
+} // namespace Profiler
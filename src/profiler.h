@@ -0,0 +1,106 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+/**
+ * @brief Collects the time spent and bytes processed in each phase of a run, see --profile
+ * @note Everything is a no-op until Enable() is called, a disabled timer costs a single branch
+ */
+namespace Profiler {
+
+enum class Phase {
+    Load,       //!< Opening and mapping a save file
+    Validate,   //!< Checking a save file is an Elden Ring save file
+    ParseSlots, //!< Decoding the metadata of slots
+    ItemScan,   //!< Scanning slot data for item records
+    ReplaceAll, //!< Search and replace passes over the save data
+    Md5,        //!< Hashing the save header and slots
+    Diff,       //!< Comparing two save files
+    Backup,     //!< Storing the changed chunks of the save file in the backup store
+    Write,      //!< Writing save data to disk
+    Count,
+};
+
+enum class Format {
+    Table,
+    Json,
+};
+
+namespace detail {
+
+struct Counter {
+    std::atomic<std::uint64_t> calls{};
+    std::atomic<std::uint64_t> nanoseconds{};
+    std::atomic<std::uint64_t> bytes{};
+};
+
+inline bool enabled{};                                                  //!< Only written once before any work starts
+inline Format format{};                                                 //!< The format of the report printed when the program exits
+inline std::array<Counter, static_cast<size_t>(Phase::Count)> phases{}; //!< Time is summed over all threads
+inline Counter searches{};                                              //!< Pattern searches over the save data, without timing
+
+} // namespace detail
+
+inline bool Enabled() {
+    return detail::enabled;
+}
+
+/**
+ * @brief Start collecting statistics, and print them in the given format once the program exits
+ */
+void Enable(Format format);
+
+/**
+ * @brief Count a pattern search, and the bytes it scanned
+ */
+inline void CountSearch(std::uint64_t bytes) {
+    if (!Enabled())
+        return;
+    detail::searches.calls.fetch_add(1, std::memory_order_relaxed);
+    detail::searches.bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Records the time between its construction and destruction for a phase
+ */
+class ScopedTimer {
+  private:
+    const Phase phase;
+    std::uint64_t bytes;
+    std::chrono::steady_clock::time_point start{};
+
+  public:
+    ScopedTimer(Phase phase, std::uint64_t bytes = 0) : phase{phase}, bytes{bytes} {
+        if (Enabled())
+            start = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Add to the bytes processed, for when they are not known up front
+     */
+    void addBytes(std::uint64_t count) {
+        bytes += count;
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    ~ScopedTimer() {
+        if (!Enabled())
+            return;
+        auto &counter{detail::phases[static_cast<size_t>(phase)]};
+        counter.calls.fetch_add(1, std::memory_order_relaxed);
+        counter.nanoseconds.fetch_add(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()), std::memory_order_relaxed);
+        counter.bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+};
+
+/**
+ * @brief Print the collected statistics to stderr, so they do not mix with the regular output
+ */
+void Print(Format format);
+
+} // namespace Profiler
@@ -0,0 +1,101 @@
+#include "generator.h"
+#include "savefile.h"
+#include <fstream>
+#include <numeric>
+#include <random>
+
+/**
+ * @brief Fills in a save file using the section layout of SaveFile and Slot, so the generated files follow any change to it
+ */
+struct SaveFileGenerator {
+    constexpr static size_t SteamIdOffset{0x100};    //!< Where the Steam ID is stored inside of a slot
+    constexpr static size_t InventoryOffset{0x1000}; //!< Where the first inventory record is stored inside of a slot
+    constexpr static size_t RecordSize{12};          //!< id groupId 00 B0 amount 00 00 00 ?? ?? 00 00
+    constexpr static size_t InventoryPadding{0x100}; //!< Empty space kept after the last record, so new items can be inserted
+
+    static size_t MaximumItemsPerSlot() {
+        return (Slot::SlotSectionSize - InventoryOffset - InventoryPadding) / RecordSize;
+    }
+
+    static void FillSlot(std::span<u8> slot, size_t slotIndex, const SaveGenerator::Options &options, std::mt19937 &random) {
+        std::uniform_int_distribution<u32> percent{0, 99};
+        std::uniform_int_distribution<u32> byte{0, 0xFF};
+        for (auto &value : slot)
+            value = percent(random) < options.noisePercent ? static_cast<u8>(byte(random)) : 0;
+
+        Section{SteamIdOffset, SaveFile::SteamIdSection.size}.replace(slot, std::span{reinterpret_cast<const u8 *>(&options.steamId), sizeof(options.steamId)});
+
+        // Every item appears once until the whole catalog has been used
+        std::vector<size_t> catalog(GeneratedItems::items.size());
+        std::iota(catalog.begin(), catalog.end(), 0);
+        std::shuffle(catalog.begin(), catalog.end(), random);
+
+        std::uniform_int_distribution<u32> quantity{1, 99};
+        const auto inventoryEnd{InventoryOffset + options.itemsPerSlot * RecordSize};
+        for (size_t itr{}, offset{InventoryOffset}; offset < inventoryEnd; itr++, offset += RecordSize) {
+            const Items::Item item{GeneratedItems::items[catalog[itr % catalog.size()]]};
+            const std::array<u8, RecordSize> record{item.data[0], item.data[1], item.data[2], item.data[3], static_cast<u8>(quantity(random)), 0, 0, 0, static_cast<u8>(slotIndex), 0, 0, 0};
+            Section{offset, record.size()}.replace(slot, record);
+        }
+        std::fill_n(slot.begin() + inventoryEnd, std::min(InventoryPadding, slot.size() - inventoryEnd), 0);
+    }
+
+    static std::vector<u8> Generate(const SaveGenerator::Options &options) {
+        if (options.activeSlots > SaveFile::SlotCount)
+            throw exception("A save file has at most {} slots, {} were requested", SaveFile::SlotCount, options.activeSlots);
+        if (options.itemsPerSlot > MaximumItemsPerSlot())
+            throw exception("At most {} items fit in a slot, {} were requested", MaximumItemsPerSlot(), options.itemsPerSlot);
+        if (options.noisePercent > 100)
+            throw exception("Invalid noise percentage {}", options.noisePercent);
+
+        std::vector<u8> data(SaveFileSize);
+        std::mt19937 random{options.seed};
+        SaveFile::HeaderBNDSection.replace(data, std::string_view{"BND"});
+        SaveFile::SteamIdSection.replace(data, std::span{reinterpret_cast<const u8 *>(&options.steamId), sizeof(options.steamId)});
+
+        for (size_t slotIndex{}; slotIndex < options.activeSlots; slotIndex++) {
+            const Slot slot{slotIndex};
+            FillSlot(slot.SlotSection.bytesFrom(data), slotIndex, options, random);
+
+            Slot::ActiveSection.bytesFrom(data)[slotIndex] = 1;
+            const auto name{fmt::format("Character{}", slotIndex)};
+            std::array<u8, Slot::NameSectionSize> convertedName{};
+            util::Utf8ToUtf16(convertedName, std::u16string(name.begin(), name.end()));
+            slot.NameSection.replace(data, convertedName);
+            slot.LevelSection.bytesFrom(data)[0] = static_cast<u8>(slotIndex + 1);
+            const auto secondsPlayed{static_cast<u32>((slotIndex + 1) * 3600 + slotIndex * 61)};
+            slot.SecondsPlayedSection.replace(data, std::span{reinterpret_cast<const u8 *>(&secondsPlayed), sizeof(secondsPlayed)});
+        }
+
+        // The checksums lie outside of every hashed region, so the slots and the save header are hashed in one batch
+        std::vector<std::span<const u8>> regions;
+        for (size_t slotIndex{}; slotIndex < SaveFile::SlotCount; slotIndex++)
+            regions.push_back(Slot{slotIndex}.SlotSection.bytesFrom(data));
+        regions.push_back(SaveFile::SaveHeaderSection.bytesFrom(data));
+        const auto hashes{util::GenerateMd5(regions)};
+        for (size_t slotIndex{}; slotIndex < SaveFile::SlotCount; slotIndex++)
+            Slot{slotIndex}.SlotChecksumSection.replace(data, hashes[slotIndex]);
+        SaveFile::SaveHeaderChecksumSection.replace(data, hashes.back());
+        return data;
+    }
+};
+
+namespace SaveGenerator {
+
+size_t MaximumItemsPerSlot() {
+    return SaveFileGenerator::MaximumItemsPerSlot();
+}
+
+std::vector<u8> Generate(const Options &options) {
+    return SaveFileGenerator::Generate(options);
+}
+
+void Write(const std::filesystem::path &path, const Options &options) {
+    const auto data{Generate(options)};
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file)
+        throw exception("Failed to write the generated save file '{}'", path.string());
+}
+
+} // namespace SaveGenerator
@@ -0,0 +1,35 @@
+#pragma once
+#include "../util.h"
+#include <filesystem>
+#include <vector>
+
+/**
+ * @brief Builds structurally valid save files from scratch, for benchmarks and load testing without a game install
+ */
+namespace SaveGenerator {
+
+struct Options {
+    size_t activeSlots{3};          //!< The amount of slots marked active, starting from slot 0. At most 10
+    size_t itemsPerSlot{400};       //!< The amount of inventory records in every active slot
+    u8 noisePercent{25};            //!< The share of random bytes in the rest of a slot, higher values produce more false delimiter matches
+    u64 steamId{76561197960287930}; //!< Stored in the save header and once in every active slot
+    u32 seed{0x5EED};               //!< Seeds the random data, the same options always produce the same file
+};
+
+/**
+ * @brief The highest amount of inventory records that fit in a slot
+ */
+size_t MaximumItemsPerSlot();
+
+/**
+ * @brief Generate the contents of a save file
+ * @note Every slot and the save header get a valid checksum, so the result can be loaded and written by SaveFile as is
+ */
+std::vector<u8> Generate(const Options &options);
+
+/**
+ * @brief Generate a save file and write it to the given path
+ */
+void Write(const std::filesystem::path &path, const Options &options);
+
+} // namespace SaveGenerator
@@ -0,0 +1,160 @@
+#include "inventory.h"
+#include "scanner.h"
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+bool IsZero(std::span<const u8> bytes) {
+    return std::all_of(bytes.begin(), bytes.end(), [](u8 byte) {
+        return byte == 0;
+    });
+}
+
+bool IsDelimiter(std::span<const u8> slot, size_t offset) {
+    return offset + 1 < slot.size() && slot[offset] == Items::ItemDelimiter[0] && slot[offset + 1] == Items::ItemDelimiter[1];
+}
+
+} // namespace
+
+SlotInventoryIndex::SlotInventoryIndex(std::span<const u8> slot) {
+    insertRange(slot, 0, slot.size());
+}
+
+void SlotInventoryIndex::insertRange(std::span<const u8> slot, size_t begin, size_t end) {
+    constexpr static auto delimiterOffset{Items::ItemSize - Items::ItemDelimiter.size()};
+    if (slot.size() < Items::ItemSize)
+        return;
+    end = std::min(end, slot.size() - Items::ItemSize + 1);
+    if (begin >= end)
+        return;
+
+    // A record starts two bytes before its delimiter
+    std::vector<Record> found;
+    for (const auto delimiter : Scanner::FindDelimiters(slot.subspan(begin + delimiterOffset, end - begin + 1))) {
+        const auto offset{begin + delimiter};
+        found.push_back({Key(slot[offset], slot[offset + 1]), static_cast<u32>(offset)});
+    }
+
+    if (records.empty()) {
+        records = std::move(found);
+        std::sort(records.begin(), records.end());
+    } else {
+        for (auto record : found)
+            records.insert(std::lower_bound(records.begin(), records.end(), record), record);
+    }
+}
+
+void SlotInventoryIndex::eraseRange(size_t begin, size_t end) {
+    std::erase_if(records, [begin, end](const Record &record) {
+        return record.offset >= begin && record.offset < end;
+    });
+}
+
+bool SlotInventoryIndex::IsEmptyRecord(std::span<const u8> slot, size_t offset) {
+    const auto isEmpty{[slot](size_t record) {
+        return IsZero(slot.subspan(record, EmptyRecordSize));
+    }};
+
+    if (offset < EmptyRecordSize || offset + EmptyRecordSize > slot.size())
+        return false;
+    const auto delimiter{offset - EmptyRecordSize};
+    if (!IsDelimiter(slot, delimiter) || !isEmpty(offset))
+        return false;
+
+    // Whether the delimiter is skipped depends on the delimiters shortly before it, go back to one that can not be skipped and decide forward from there
+    auto start{delimiter};
+    for (bool found{true}; found;) {
+        found = false;
+        for (auto itr{start >= EmptyRecordSize ? start - EmptyRecordSize : 0}; itr < start; itr++)
+            if (IsDelimiter(slot, itr)) {
+                start = itr;
+                found = true;
+                break;
+            }
+    }
+
+    size_t skipUntil{};
+    for (auto itr{start}; itr < delimiter; itr++) {
+        if (itr < skipUntil || !IsDelimiter(slot, itr))
+            continue;
+        if (!isEmpty(itr + EmptyRecordSize))
+            skipUntil = itr + EmptyRecordSize + 1;
+    }
+    return delimiter >= skipUntil;
+}
+
+std::vector<u32> SlotInventoryIndex::FindEmptyRecords(std::span<const u8> slot) {
+    std::vector<u32> result;
+    size_t skipUntil{};
+    for (const size_t delimiter : Scanner::FindDelimiters(slot)) {
+        if (delimiter < skipUntil)
+            continue;
+
+        const auto record{delimiter + EmptyRecordSize};
+        if (record + EmptyRecordSize > slot.size())
+            break;
+
+        // A delimiter within the bytes following an occupied record is part of that record
+        if (IsZero(slot.subspan(record, EmptyRecordSize)))
+            result.push_back(static_cast<u32>(record));
+        else
+            skipUntil = delimiter + EmptyRecordSize + 1;
+    }
+
+    std::reverse(result.begin(), result.end());
+    return result;
+}
+
+void SlotInventoryIndex::updateEmptyRecords(std::span<const u8> slot, size_t begin, size_t end) {
+    // The written bytes can be part of an empty record, the delimiter before one, or a record that decides if the delimiters shortly after it are skipped.
+    // Those can in turn decide if the delimiters after them are skipped, so chains of close delimiters are followed
+    const auto first{begin >= EmptyRecordSize - 1 ? begin - (EmptyRecordSize - 1) : 0};
+    auto lastDelimiter{end + EmptyRecordSize - 1};
+    for (auto itr{lastDelimiter + 1}; itr <= lastDelimiter + EmptyRecordSize && itr < slot.size(); itr++)
+        if (IsDelimiter(slot, itr))
+            lastDelimiter = itr;
+    const auto last{std::min(lastDelimiter + EmptyRecordSize + 1, slot.size())};
+    for (auto offset{first}; offset < last; offset++) {
+        if (!IsEmptyRecord(slot, offset))
+            continue;
+        const auto position{std::lower_bound(emptyRecords->begin(), emptyRecords->end(), offset, std::greater<>{})};
+        if (position == emptyRecords->end() || *position != offset)
+            emptyRecords->insert(position, static_cast<u32>(offset));
+    }
+}
+
+std::optional<size_t> SlotInventoryIndex::takeEmptyRecord(std::span<const u8> slot) {
+    if (!emptyRecords)
+        emptyRecords = FindEmptyRecords(slot);
+
+    while (!emptyRecords->empty()) {
+        const size_t offset{emptyRecords->back()};
+        emptyRecords->pop_back();
+        if (IsEmptyRecord(slot, offset))
+            return offset;
+    }
+    return std::nullopt;
+}
+
+std::optional<size_t> SlotInventoryIndex::find(Items::Item item) const {
+    const auto key{Key(item.id, item.group)};
+    const auto result{std::lower_bound(records.begin(), records.end(), Record{key, 0})};
+    if (result != records.end() && result->key == key)
+        return result->offset;
+    return std::nullopt;
+}
+
+void SlotInventoryIndex::write(std::span<u8> slot, size_t offset, std::span<const u8> bytes) {
+    if (offset + bytes.size() > slot.size())
+        throw exception("Invalid offset range while writing to slot: [0x{:X}, 0x{:X}], size: 0x{:X}", offset, offset + bytes.size(), slot.size());
+
+    // Any record overlapping the written bytes might get created or destroyed
+    const auto begin{offset >= Items::ItemSize - 1 ? offset - (Items::ItemSize - 1) : 0};
+    const auto end{offset + bytes.size()};
+    eraseRange(begin, end);
+    std::copy(bytes.begin(), bytes.end(), slot.begin() + offset);
+    insertRange(slot, begin, end);
+    if (emptyRecords)
+        updateEmptyRecords(slot, offset, end);
+}
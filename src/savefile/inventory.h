@@ -0,0 +1,78 @@
+#pragma once
+#include "items.h"
+#include <optional>
+#include <span>
+#include <vector>
+
+/**
+ * @brief An index of all item records in a slot, mapping the id and group of an item to its offsets
+ * @note Offsets are relative to the start of the slots data section
+ */
+class SlotInventoryIndex {
+  private:
+    struct Record {
+        u16 key;    //!< The id and group of the item, in the order they are stored in the save file
+        u32 offset; //!< The offset of the first byte of the record
+
+        constexpr auto operator<=>(const Record &) const = default;
+    };
+
+    constexpr static size_t EmptyRecordSize{10}; //!< An empty record is this many zero bytes, starting this many bytes after the delimiter of the previous record
+
+    std::vector<Record> records;                    //!< All records in the slot, sorted by key and then by offset
+    std::optional<std::vector<u32>> emptyRecords{}; //!< Offsets at which a new item can be inserted, sorted in descending order so the first one is taken from the back. Built on the first insertion
+
+    constexpr static u16 Key(u8 id, u8 group) {
+        return static_cast<u16>(id | (group << 8));
+    }
+
+    /**
+     * @brief Index all records starting inside of the given range
+     */
+    void insertRange(std::span<const u8> slot, size_t begin, size_t end);
+
+    /**
+     * @brief Remove all records starting inside of the given range
+     */
+    void eraseRange(size_t begin, size_t end);
+
+    /**
+     * @brief Check if a new item can be inserted at an offset: it directly follows the delimiter of another record, is empty and is not part of the previous record
+     * @note Delimiters within the bytes following an occupied record belong to that record, those are skipped like the first scan skips them
+     */
+    static bool IsEmptyRecord(std::span<const u8> slot, size_t offset);
+
+    /**
+     * @brief Find every offset at which a new item can be inserted, with a single pass over the slot
+     */
+    static std::vector<u32> FindEmptyRecords(std::span<const u8> slot);
+
+    /**
+     * @brief Add the empty records a write to the given range might have created, so the list stays complete
+     */
+    void updateEmptyRecords(std::span<const u8> slot, size_t begin, size_t end);
+
+  public:
+    /**
+     * @brief Build the index with a single pass over the slot
+     */
+    SlotInventoryIndex(std::span<const u8> slot);
+
+    /**
+     * @brief Get the offset of the first record of an item, if it is present
+     */
+    std::optional<size_t> find(Items::Item item) const;
+
+    /**
+     * @brief Take the first empty record following another record, to insert an item into
+     * @return The offset of the empty record, if the slot has one left
+     * @note Records that were filled since they were listed are dropped when they are reached, so taking a record is constant time apart from the first call
+     */
+    std::optional<size_t> takeEmptyRecord(std::span<const u8> slot);
+
+    /**
+     * @brief Write to the slot while keeping the index up to date
+     * @param offset The offset relative to the start of the slot to write the bytes to
+     */
+    void write(std::span<u8> slot, size_t offset, std::span<const u8> bytes);
+};
@@ -2,22 +2,15 @@
 
 namespace Items {
 
-const std::string Items::findId(ItemResult item) {
-    const auto result{std::find_if(this->begin(), this->end(), [item](const auto &v) {
-        return v.second.id == item.item.id;
-    })};
-    if (result != this->end())
-        return result->first;
+std::string_view Items::findId(ItemResult item) const {
+    if (const auto result{GeneratedItems::FindId(static_cast<u16>(item.item.id | item.item.group << 8))})
+        return result->name;
     return {};
 }
 
-ItemGroup Items::hasGroup(ItemResult item) {
-    const auto result{std::find_if(groups.begin(), groups.end(), [item](const ItemGroup &v) {
-        return v.id == item.item.group;
-    })};
-
-    if (result != groups.end())
-        return *result;
+ItemGroup Items::hasGroup(ItemResult item) const {
+    if (const auto &group{GeneratedItems::groups[item.item.group]}; group.known)
+        return {group.name, item.item.group};
     return {false};
 }
 
@@ -32,15 +25,15 @@ bool ItemResult::operator<(const ItemResult &rhs) {
         return name < rhs.name;
 }
 
-const Item Items::operator[](std::string_view name) {
-    if (this->find(name.data()) != this->end())
-        return this->at(name.data());
+const Item Items::operator[](std::string_view name) const {
+    if (const auto item{GeneratedItems::Find(name)})
+        return *item;
     throw exception("Unknown item '{}'", name);
 }
 
 void Items::print() const {
-    for (auto item : *this)
-        fmt::print("{}\n", item.first);
+    for (const auto &item : *this)
+        fmt::print("{}\n", item.name);
 };
 
 } // namespace Items
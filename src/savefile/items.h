@@ -1,9 +1,8 @@
+#pragma once
 #include "../codegen/generateditems.h"
 #include "../util.h"
 #include <array>
-#include <list>
 #include <vector>
-#include <map>
 
 namespace Items {
 
@@ -18,6 +17,7 @@ struct Item {
     std::array<u8, ItemSize> data;
 
     constexpr Item(u8 id, u8 groupId) : id{id}, group{groupId}, data{id, groupId, ItemDelimiter.front(), ItemDelimiter.back()} {}
+    constexpr Item(GeneratedItems::Item item) : Item{static_cast<u8>(item.id & 0xff), static_cast<u8>(item.id >> 8)} {}
     constexpr Item() : data{0, 0, ItemDelimiter.front(), ItemDelimiter.back()} {}
 };
 
@@ -46,40 +46,38 @@ struct ItemGroup {
     ItemGroup(bool found) : found{found} {}
 };
 
-// TODO: make this a struct rather than a pair. This kinda sucks.
-using ItemList = std::map<std::string, Item>;
-
 /**
- * @brief A map of items containting data that can be searched and replaced
+ * @brief All items containting data that can be searched and replaced
+ * @note This is a view over the tables in generateditems.h, names are resolved with a perfect hash generated at compile time
  */
-class Items : public ItemList {
+class Items {
   private:
-    // clang-format off
-    std::list<ItemGroup> groups{
-        {"Rune", 0xB},
-        {"SmithingStone", 0x27},
-        {"FowlFoot", 0x4},
-        {"CraftingMaterial", 0x51},
-        {"Glovewort", 0x2A},
-        {"BeastBone", 0x3B},
-    };
-    // clang-format on
-
     ItemGroup group(std::string_view name);
 
   public:
-    Items() {
-        for (auto item : GeneratedItems::items) {
-            Item i{static_cast<u8>(item.id & 0xff), static_cast<u8>(item.id >> 8)};
-            this->emplace(item.name, i);
-        }
+    const Item operator[](std::string_view name) const;
+
+    /**
+     * @brief Iterate over all items, sorted by name
+     */
+    constexpr auto begin() const {
+        return GeneratedItems::items.begin();
     }
 
-    const Item operator[](std::string_view name);
+    constexpr auto end() const {
+        return GeneratedItems::items.end();
+    }
 
-    const std::string findId(ItemResult item);
+    /**
+     * @brief Get the name of an item by its id and group
+     * @return The name, or an empty string if the item is unknown
+     */
+    std::string_view findId(ItemResult item) const;
 
-    ItemGroup hasGroup(ItemResult item);
+    /**
+     * @brief Get the group of an item, if any items in ERDB belong to it
+     */
+    ItemGroup hasGroup(ItemResult item) const;
 
     void print() const;
 };
@@ -0,0 +1,133 @@
+#include "patch.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+void WriteNumber(std::ostream &stream, size_t value) {
+    const auto number{static_cast<u32>(value)};
+    stream.write(reinterpret_cast<const char *>(&number), sizeof(number));
+}
+
+size_t ReadNumber(std::istream &stream) {
+    u32 number{};
+    stream.read(reinterpret_cast<char *>(&number), sizeof(number));
+    return number;
+}
+
+} // namespace
+
+Patch Patch::Diff(std::span<const u8> source, std::span<const u8> target, const std::vector<Section> &ignored, std::vector<size_t> boundaries) {
+    if (source.size() != target.size())
+        throw exception("Can not compare files of 0x{:X} and 0x{:X} bytes", source.size(), target.size());
+    Profiler::ScopedTimer timer{Profiler::Phase::Diff, source.size() + target.size()};
+
+    const auto isIgnored{[&ignored](size_t offset) {
+        return std::any_of(ignored.begin(), ignored.end(), [offset](const Section &section) {
+            return offset >= section.address && offset < section.length;
+        });
+    }};
+
+    std::sort(boundaries.begin(), boundaries.end());
+    const auto crossesBoundary{[&boundaries](size_t begin, size_t end) {
+        const auto boundary{std::upper_bound(boundaries.begin(), boundaries.end(), begin)};
+        return boundary != boundaries.end() && *boundary <= end;
+    }};
+
+    // memcmp is vectorized, so identical blocks are skipped at about the speed of reading them
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t block{}; block < source.size(); block += BlockSize) {
+        const auto end{std::min(block + BlockSize, source.size())};
+        if (std::memcmp(source.data() + block, target.data() + block, end - block) == 0)
+            continue;
+
+        for (size_t offset{block}; offset < end; offset++) {
+            if (source[offset] == target[offset] || isIgnored(offset))
+                continue;
+            if (!ranges.empty() && offset - ranges.back().second <= MergeDistance && !crossesBoundary(ranges.back().first, offset))
+                ranges.back().second = offset + 1;
+            else
+                ranges.emplace_back(offset, offset + 1);
+        }
+    }
+
+    Patch patch;
+    util::Md5Context context;
+    for (const auto &[begin, end] : ranges) {
+        patch.changes.push_back({Section{begin, end - begin}, {target.begin() + begin, target.begin() + end}});
+        context.update(source.subspan(begin, end - begin));
+    }
+    patch.sourceHash = context.finish();
+    return patch;
+}
+
+Patch Patch::FromFile(const std::filesystem::path &path) {
+    const auto target{util::ToAbsolutePath(path).generic_string()};
+    std::ifstream stream{path, std::ios::binary};
+    if (!stream)
+        throw exception("Could not open patch '{}'", target);
+
+    std::array<u8, Magic.size()> magic{};
+    stream.read(reinterpret_cast<char *>(magic.data()), magic.size());
+    if (magic != Magic)
+        throw exception("'{}' is not a patch created by --diff", target);
+
+    Patch patch;
+    const auto fileSize{std::filesystem::file_size(path)};
+    const auto count{ReadNumber(stream)};
+    stream.read(reinterpret_cast<char *>(patch.sourceHash.data()), patch.sourceHash.size());
+    for (size_t itr{}; itr < count && stream; itr++) {
+        const auto address{ReadNumber(stream)};
+        const auto size{ReadNumber(stream)};
+        if (size > fileSize)
+            break;
+        std::vector<u8> bytes(size);
+        stream.read(reinterpret_cast<char *>(bytes.data()), static_cast<std::streamsize>(size));
+        patch.changes.push_back({Section{address, size}, std::move(bytes)});
+    }
+    if (!stream || patch.changes.size() != count)
+        throw exception("The patch '{}' is truncated", target);
+    return patch;
+}
+
+void Patch::write(const std::filesystem::path &path) const {
+    std::ofstream stream{path, std::ios::binary | std::ios::trunc};
+    stream.write(reinterpret_cast<const char *>(Magic.data()), Magic.size());
+    WriteNumber(stream, changes.size());
+    stream.write(reinterpret_cast<const char *>(sourceHash.data()), sourceHash.size());
+    for (const auto &[section, bytes] : changes) {
+        WriteNumber(stream, section.address);
+        WriteNumber(stream, section.size);
+        stream.write(reinterpret_cast<const char *>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    }
+    if (!stream.flush())
+        throw exception("Could not write patch '{}'", util::ToAbsolutePath(path).generic_string());
+}
+
+std::vector<Section> Patch::apply(std::span<u8> data) const {
+    util::Md5Context context;
+    bool applied{true};
+    for (const auto &[section, bytes] : changes) {
+        if (section.length > data.size())
+            throw exception("The patch changes 0x{:X} bytes at 0x{:X}, past the end of the file", section.size, section.address);
+        context.update(section.bytesFrom(data));
+        applied &= std::ranges::equal(section.bytesFrom(data), bytes);
+    }
+    if (context.finish() != sourceHash)
+        throw exception("{}", applied ? "The patch is already applied" : "The patch was created from a different file");
+
+    std::vector<Section> written;
+    for (const auto &[section, bytes] : changes) {
+        std::copy(bytes.begin(), bytes.end(), data.begin() + section.address);
+        written.push_back(section);
+    }
+    return written;
+}
+
+size_t Patch::changedBytes() const {
+    size_t bytes{};
+    for (const auto &change : changes)
+        bytes += change.section.size;
+    return bytes;
+}
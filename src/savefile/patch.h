@@ -0,0 +1,63 @@
+#pragma once
+#include "../util.h"
+#include <array>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+/**
+ * @brief The ranges in which one save file differs from another, along with the bytes of the other file, see --diff and --apply-patch
+ * @note Stored as the magic 'ERPATCH' followed by a version byte, the amount of changes, the MD5 of the original bytes of all changes, and the address, size and bytes of every change. Numbers are 32 bit little endian
+ */
+class Patch {
+  public:
+    struct Change {
+        Section section;       //!< The range of the file to replace
+        std::vector<u8> bytes; //!< The bytes of the other file in that range
+    };
+
+  private:
+    constexpr static std::array<u8, 8> Magic{'E', 'R', 'P', 'A', 'T', 'C', 'H', 1};
+    constexpr static size_t BlockSize{4096};  //!< Files are compared in blocks of this size, only differing blocks are compared byte by byte
+    constexpr static size_t MergeDistance{8}; //!< Changes this close together are merged, storing the bytes between them is cheaper than another address and size
+
+    std::vector<Change> changes;
+    util::Md5Hash sourceHash{}; //!< The MD5 of the original bytes of all changes, so the patch is only applied to the file it was created from
+
+    Patch() = default;
+
+  public:
+    /**
+     * @brief Compare two files of the same size
+     * @param ignored Ranges whose bytes are treated as equal, for data that is derived from the rest of the file
+     * @param boundaries Offsets no change spans across, even if the bytes on both sides differ
+     */
+    static Patch Diff(std::span<const u8> source, std::span<const u8> target, const std::vector<Section> &ignored = {}, std::vector<size_t> boundaries = {});
+
+    static Patch FromFile(const std::filesystem::path &path);
+
+    void write(const std::filesystem::path &path) const;
+
+    /**
+     * @brief Replace the changed ranges of the data, after checking it matches the file the patch was created from
+     * @return The sections that were written to
+     */
+    std::vector<Section> apply(std::span<u8> data) const;
+
+    /**
+     * @brief The amount of bytes that differ, including the bytes between merged changes
+     */
+    size_t changedBytes() const;
+
+    size_t size() const {
+        return changes.size();
+    }
+
+    auto begin() const {
+        return changes.begin();
+    }
+
+    auto end() const {
+        return changes.end();
+    }
+};
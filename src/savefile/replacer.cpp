@@ -0,0 +1,279 @@
+#include "replacer.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define REPLACER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+using Patterns = std::vector<std::span<const u8>>;
+using Offsets = std::vector<std::vector<size_t>>;
+
+/**
+ * @brief Whether a pattern only consists of zeros, like the name of a character that was never named. It matches at almost every offset of the mostly empty save data
+ */
+bool IsZero(std::span<const u8> pattern) {
+    return std::all_of(pattern.begin(), pattern.end(), [](u8 value) { return value == 0x0; });
+}
+
+bool MatchesAt(std::span<const u8> data, size_t offset, std::span<const u8> pattern) {
+    return offset + pattern.size() <= data.size() && std::memcmp(data.data() + offset, pattern.data(), pattern.size()) == 0;
+}
+
+/**
+ * @brief Check every offset in [begin, end) against every pattern, used for the tail of the vectorized kernels
+ */
+void ScanNaive(std::span<const u8> data, const Patterns &patterns, size_t begin, size_t end, Offsets &offsets) {
+    for (size_t offset{begin}; offset < end; offset++)
+        for (size_t pattern{}; pattern < patterns.size(); pattern++)
+            if (data[offset] == patterns[pattern].front() && MatchesAt(data, offset, patterns[pattern]))
+                offsets[pattern].push_back(offset);
+}
+
+/**
+ * @brief Horspool for a set of patterns: the window is as long as the shortest pattern, and is shifted by the smallest shift of any pattern
+ */
+void ScanHorspool(std::span<const u8> data, const Patterns &patterns, Offsets &offsets) {
+    auto window{patterns.front().size()};
+    for (const auto &pattern : patterns)
+        window = std::min(window, pattern.size());
+
+    std::array<size_t, 0x100> shifts;
+    shifts.fill(window);
+    for (const auto &pattern : patterns)
+        for (size_t itr{}; itr + 1 < window; itr++)
+            shifts[pattern[itr]] = std::min(shifts[pattern[itr]], window - 1 - itr);
+
+    // Save data is mostly zeros and names are UTF-16, so shifts are often short and most windows are rejected by their first byte instead
+    std::array<bool, 0x100> firstBytes{};
+    for (const auto &pattern : patterns)
+        firstBytes[pattern.front()] = true;
+
+    for (size_t offset{}; offset + window <= data.size(); offset += shifts[data[offset + window - 1]]) {
+        if (!firstBytes[data[offset]])
+            continue;
+        for (size_t pattern{}; pattern < patterns.size(); pattern++)
+            if (MatchesAt(data, offset, patterns[pattern]))
+                offsets[pattern].push_back(offset);
+    }
+}
+
+template <typename Mask> void VerifyMask(std::span<const u8> data, std::span<const u8> pattern, Mask mask, size_t offset, std::vector<size_t> &result) {
+    while (mask) {
+        const auto candidate{offset + std::countr_zero(mask)};
+        if (MatchesAt(data, candidate, pattern))
+            result.push_back(candidate);
+        mask &= mask - 1;
+    }
+}
+
+size_t LongestPattern(const Patterns &patterns) {
+    size_t longest{};
+    for (const auto &pattern : patterns)
+        longest = std::max(longest, pattern.size());
+    return longest;
+}
+
+#ifdef REPLACER_X86
+__attribute__((target("sse2"))) void ScanSse2(std::span<const u8> data, const Patterns &patterns, Offsets &offsets) {
+    constexpr static size_t Width{sizeof(__m128i)};
+    const auto longest{LongestPattern(patterns)};
+
+    size_t offset{};
+    for (; offset + Width + longest - 1 <= data.size(); offset += Width) {
+        const auto current{_mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + offset))};
+        for (size_t pattern{}; pattern < patterns.size(); pattern++) {
+            // The last byte of a pattern is compared as well, which rejects most candidates sharing only the first byte
+            const auto end{_mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + offset + patterns[pattern].size() - 1))};
+            const auto first{_mm_set1_epi8(static_cast<char>(patterns[pattern].front()))};
+            const auto last{_mm_set1_epi8(static_cast<char>(patterns[pattern].back()))};
+            const auto match{_mm_and_si128(_mm_cmpeq_epi8(current, first), _mm_cmpeq_epi8(end, last))};
+            VerifyMask(data, patterns[pattern], static_cast<u32>(_mm_movemask_epi8(match)), offset, offsets[pattern]);
+        }
+    }
+
+    ScanNaive(data, patterns, offset, data.size(), offsets);
+}
+
+__attribute__((target("avx2"))) void ScanAvx2(std::span<const u8> data, const Patterns &patterns, Offsets &offsets) {
+    constexpr static size_t Width{sizeof(__m256i)};
+    const auto longest{LongestPattern(patterns)};
+
+    size_t offset{};
+    for (; offset + Width + longest - 1 <= data.size(); offset += Width) {
+        const auto current{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data.data() + offset))};
+        for (size_t pattern{}; pattern < patterns.size(); pattern++) {
+            // The last byte of a pattern is compared as well, which rejects most candidates sharing only the first byte
+            const auto end{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data.data() + offset + patterns[pattern].size() - 1))};
+            const auto first{_mm256_set1_epi8(static_cast<char>(patterns[pattern].front()))};
+            const auto last{_mm256_set1_epi8(static_cast<char>(patterns[pattern].back()))};
+            const auto match{_mm256_and_si256(_mm256_cmpeq_epi8(current, first), _mm256_cmpeq_epi8(end, last))};
+            VerifyMask(data, patterns[pattern], static_cast<u32>(_mm256_movemask_epi8(match)), offset, offsets[pattern]);
+        }
+    }
+
+    ScanNaive(data, patterns, offset, data.size(), offsets);
+}
+#endif
+
+using Kernel = void (*)(std::span<const u8>, const Patterns &, Offsets &);
+
+/**
+ * @brief Select the scan kernel once, based on the features of the CPU we are running on
+ */
+Kernel SelectKernel() {
+#ifdef REPLACER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return ScanAvx2;
+    if (__builtin_cpu_supports("sse2"))
+        return ScanSse2;
+#endif
+    return ScanHorspool;
+}
+
+} // namespace
+
+std::vector<OccurrenceIndex::Entry>::iterator OccurrenceIndex::entry(std::span<const u8> pattern) {
+    return std::find_if(entries.begin(), entries.end(), [pattern](const Entry &entry) {
+        return std::ranges::equal(entry.pattern, pattern);
+    });
+}
+
+bool OccurrenceIndex::contains(std::span<const u8> pattern) const {
+    return std::any_of(entries.begin(), entries.end(), [pattern](const Entry &entry) {
+        return std::ranges::equal(entry.pattern, pattern);
+    });
+}
+
+void OccurrenceIndex::record(std::span<const u8> pattern, std::vector<size_t> offsets) {
+    if (const auto existing{entry(pattern)}; existing != entries.end())
+        entries.erase(existing);
+    if (entries.size() == MaximumEntries)
+        entries.erase(entries.begin());
+    entries.push_back({{pattern.begin(), pattern.end()}, std::move(offsets)});
+}
+
+void OccurrenceIndex::invalidate(Section section) {
+    std::erase_if(entries, [section](Entry &entry) {
+        // Any occurrence overlapping the range could have been broken, and new ones can start up to a pattern length before it
+        const auto margin{std::min(section.address, entry.pattern.size() - 1)};
+        const Section affected{section.address - margin, section.size + margin};
+        std::erase_if(entry.offsets, [&affected](size_t offset) {
+            return offset >= affected.address && offset < affected.length;
+        });
+        // Replacements are usually invalidated by both the replacer and its caller
+        if (entry.dirty.empty() || entry.dirty.back().address != affected.address || entry.dirty.back().length != affected.length)
+            entry.dirty.push_back(affected);
+        return entry.dirty.size() > MaximumDirtySections;
+    });
+}
+
+std::optional<std::vector<size_t>> OccurrenceIndex::find(std::span<const u8> data, std::span<const u8> pattern) {
+    const auto indexed{entry(pattern)};
+    if (indexed == entries.end())
+        return std::nullopt;
+
+    auto &offsets{indexed->offsets};
+    for (const auto &dirty : indexed->dirty) {
+        const auto begin{std::min(dirty.address, data.size())};
+        const auto end{std::min(dirty.length + pattern.size() - 1, data.size())};
+        const auto found{Replacer::FindAll(data.subspan(begin, end - begin), {pattern})};
+        for (const auto offset : found.front())
+            offsets.push_back(begin + offset);
+    }
+
+    if (!indexed->dirty.empty()) {
+        std::sort(offsets.begin(), offsets.end());
+        offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+        indexed->dirty.clear();
+    }
+    return offsets;
+}
+
+Replacer &Replacer::add(std::span<const u8> find, std::span<const u8> replace) {
+    if (find.empty() || find.size() != replace.size())
+        throw exception("Size of find does not match replace");
+    patterns.push_back({{find.begin(), find.end()}, {replace.begin(), replace.end()}});
+    return *this;
+}
+
+Replacer &Replacer::watch(std::span<const u8> find) {
+    if (find.empty())
+        throw exception("Can not watch an empty pattern");
+    if (IsZero(find))
+        return *this;
+    for (const auto &pattern : patterns)
+        if (std::ranges::equal(pattern.find, find))
+            return *this;
+    patterns.push_back({{find.begin(), find.end()}, {}});
+    return *this;
+}
+
+std::vector<std::vector<size_t>> Replacer::FindAll(std::span<const u8> data, const std::vector<std::span<const u8>> &patterns) {
+    static const auto kernel{SelectKernel()};
+    Offsets offsets(patterns.size());
+    if (patterns.empty())
+        return offsets;
+
+    Profiler::ScopedTimer timer{Profiler::Phase::ReplaceAll, data.size_bytes()};
+    Profiler::CountSearch(data.size_bytes());
+    kernel(data, patterns, offsets);
+    return offsets;
+}
+
+bool Replacer::indexedBy(const OccurrenceIndex &index) const {
+    return std::all_of(patterns.begin(), patterns.end(), [&index](const Pattern &pattern) {
+        return index.contains(pattern.find);
+    });
+}
+
+std::vector<Section> Replacer::apply(std::span<u8> data, OccurrenceIndex *index) const {
+    // Only search for the patterns the index cannot answer, all of them in one pass
+    Offsets found(patterns.size());
+    Patterns searched;
+    std::vector<size_t> searchedPatterns;
+    for (size_t pattern{}; pattern < patterns.size(); pattern++) {
+        if (index)
+            if (auto offsets{index->find(data, patterns[pattern].find)}) {
+                found[pattern] = std::move(*offsets);
+                continue;
+            }
+        searched.push_back(patterns[pattern].find);
+        searchedPatterns.push_back(pattern);
+    }
+
+    auto searchResults{FindAll(data, searched)};
+    for (size_t itr{}; itr < searchedPatterns.size(); itr++) {
+        if (index && !IsZero(patterns[searchedPatterns[itr]].find))
+            index->record(patterns[searchedPatterns[itr]].find, searchResults[itr]);
+        found[searchedPatterns[itr]] = std::move(searchResults[itr]);
+    }
+
+    // Replace in order of the offsets, an earlier replacement can overwrite a later occurrence so each one is checked again
+    std::vector<std::pair<size_t, size_t>> occurrences;
+    for (size_t pattern{}; pattern < patterns.size(); pattern++)
+        if (!patterns[pattern].replace.empty())
+            for (const auto offset : found[pattern])
+                occurrences.emplace_back(offset, pattern);
+    std::sort(occurrences.begin(), occurrences.end());
+
+    std::vector<Section> replaced;
+    for (const auto &[offset, pattern] : occurrences) {
+        const auto &[find, replace]{patterns[pattern]};
+        // Replacing a pattern with itself, like copying a character between files of the same account, leaves nothing modified
+        if (!MatchesAt(data, offset, find) || find == replace)
+            continue;
+
+        std::copy(replace.begin(), replace.end(), data.begin() + offset);
+        replaced.emplace_back(offset, replace.size());
+        if (index)
+            index->invalidate(replaced.back());
+    }
+    return replaced;
+}
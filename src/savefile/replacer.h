@@ -0,0 +1,92 @@
+#pragma once
+#include "../util.h"
+#include <optional>
+#include <span>
+#include <vector>
+
+/**
+ * @brief Remembers where patterns occur in a buffer, so searching for them again only has to rescan the ranges modified since
+ */
+class OccurrenceIndex {
+  private:
+    struct Entry {
+        std::vector<u8> pattern;      //!< The bytes that were searched for
+        std::vector<size_t> offsets;  //!< Where the pattern occurs, excluding the dirty ranges
+        std::vector<Section> dirty{}; //!< Ranges modified since the pattern was last searched for
+    };
+
+    constexpr static size_t MaximumEntries{16};        //!< The oldest entry is dropped once this many patterns are indexed
+    constexpr static size_t MaximumDirtySections{256}; //!< Past this an entry is dropped, as rescanning would cost about as much as a full scan
+    std::vector<Entry> entries;
+
+    std::vector<Entry>::iterator entry(std::span<const u8> pattern);
+
+  public:
+    bool contains(std::span<const u8> pattern) const;
+
+    /**
+     * @brief Store the result of a full search
+     * @param offsets All occurrences of the pattern, sorted
+     */
+    void record(std::span<const u8> pattern, std::vector<size_t> offsets);
+
+    /**
+     * @brief Mark a range of the buffer as modified for every indexed pattern
+     */
+    void invalidate(Section section);
+
+    /**
+     * @brief Get all occurrences of an indexed pattern, rescanning only the ranges modified since it was recorded
+     * @return The sorted offsets, or nothing if the pattern is not indexed
+     */
+    std::optional<std::vector<size_t>> find(std::span<const u8> data, std::span<const u8> pattern);
+
+    void clear() {
+        entries.clear();
+    }
+};
+
+/**
+ * @brief Replaces several patterns in a single pass over the data
+ * @note Candidates are found by comparing the first and last byte of every pattern using the widest vector instructions the CPU supports, then verified in full
+ */
+class Replacer {
+  private:
+    struct Pattern {
+        std::vector<u8> find;
+        std::vector<u8> replace; //!< Empty if the pattern is only located, see watch()
+    };
+
+    std::vector<Pattern> patterns;
+
+  public:
+    /**
+     * @brief Replace every occurrence of find
+     * @note If two patterns match at the same offset, the one added first is used
+     */
+    Replacer &add(std::span<const u8> find, std::span<const u8> replace);
+
+    /**
+     * @brief Only locate a pattern, so its occurrences are indexed for a later replace
+     * @note Patterns of only zeros are ignored, they would fill the index with nearly every offset of the data
+     */
+    Replacer &watch(std::span<const u8> find);
+
+    /**
+     * @brief Whether all patterns can be answered by the index, so applying them does not scan the whole data
+     */
+    bool indexedBy(const OccurrenceIndex &index) const;
+
+    /**
+     * @brief Apply all replacements
+     * @param index Used to skip searching for patterns that are already indexed, all searched patterns except those of only zeros are recorded in it
+     * @return The replaced ranges, sorted by address. Occurrences of a pattern that replaces itself are left out
+     */
+    std::vector<Section> apply(std::span<u8> data, OccurrenceIndex *index = nullptr) const;
+
+    /**
+     * @brief Find all occurrences of several patterns in a single pass
+     * @return For every pattern, the sorted offsets of its occurrences
+     */
+    static std::vector<std::vector<size_t>> FindAll(std::span<const u8> data, const std::vector<std::span<const u8>> &patterns);
+};
@@ -1,14 +1,22 @@
 #include "savefile.h"
+#include "../md5.h"
 #include "../util.h"
+#include "scanner.h"
+#include <fcntl.h>
 #include <fstream>
 #include <span>
 #include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
 
-void Slot::copy(SaveSpan source, SaveSpan target, size_t targetSlotIndex) const {
+std::array<Section, 3> Slot::copy(SaveSpan source, SaveSpan target, size_t targetSlotIndex) const {
     const auto targetSlotSection{ParseSlot(SlotSectionOffset, SlotSection.size, targetSlotIndex)};
+    const auto targetChecksumSection{ParseSlot(SlotChecksumSectionOffset, SlotChecksumSection.size, targetSlotIndex)};
     const auto targetHeaderSection{ParseHeader(SlotHeaderSectionOffset, SlotHeaderSection.size, targetSlotIndex)};
     targetSlotSection.replace(target, SlotSection.bytesFrom(source));
+    targetChecksumSection.replace(target, SlotChecksumSection.bytesFrom(source));
     targetHeaderSection.replace(target, SlotHeaderSection.bytesFrom(source));
+    return {targetSlotSection, targetChecksumSection, targetHeaderSection};
 }
 
 void Slot::debugListItems(SaveSpan data) {
@@ -17,20 +25,20 @@ void Slot::debugListItems(SaveSpan data) {
     std::vector<Items::ItemResult> unknown{};
     Items::Items known;
 
-    for (auto itr{slot.begin()}; itr + 2 != slot.end(); itr++) {
-        if (*itr == Items::ItemDelimiter.front() && *(itr + 1) == Items::ItemDelimiter.back()) [[unlikely]] {
-            const Items::ItemResult item{static_cast<size_t>(itr - slot.begin()), {*(itr - 2), *(itr - 1)}};
-            const auto group{known.hasGroup(item)};
-            const auto quantity{getItemQuantity(data, item.item)};
-            if (!quantity) // Probably isnt an item
-                continue;
-
-            if (group.found && known.findId(item).empty()) // Ignore items we already know
-                recognized.emplace_back(item, group.name, quantity);
-            else
-                unknown.emplace_back(item, quantity);
-        } else if (*(itr + 1) != Items::ItemDelimiter.front()) [[likely]]
-            itr++;
+    for (const auto offset : Scanner::FindDelimiters(slot)) {
+        if (offset < Items::ItemSize - Items::ItemDelimiter.size()) // The id and group would be out of bounds
+            continue;
+
+        const Items::ItemResult item{offset, {slot[offset - 2], slot[offset - 1]}};
+        const auto group{known.hasGroup(item)};
+        const auto quantity{getItemQuantity(data, item.item)};
+        if (!quantity) // Probably isnt an item
+            continue;
+
+        if (!group.found)
+            unknown.emplace_back(item, quantity);
+        else if (known.findId(item).empty()) // Ignore items we already know
+            recognized.emplace_back(item, group.name, quantity);
     }
 
     // TODO: this sometimes doesnt find all duplicates, no idea why
@@ -71,62 +79,115 @@ void Slot::debugListItems(SaveSpan data) {
     }
 }
 
-void Slot::recalculateSlotChecksum(SaveSpan data) const {
-    auto hash{util::GenerateMd5(SlotSection.bytesFrom(data))};
+std::span<u8> Slot::checksummedData(SaveSpan data) const {
+    return SlotSection.bytesFrom(data);
+}
+
+Section Slot::setChecksum(SaveSpan data, const util::Md5Hash &hash) const {
     SlotChecksumSection.replace(data, hash);
+    return SlotChecksumSection;
 }
 
-void Slot::rename(SaveSpan data, std::string_view newName) const {
+void Slot::rename(SaveSpan data, std::string_view newName, Replacer &replacer) const {
     std::array<u8, NameSectionSize> convertedName{};
     util::Utf8ToUtf16(convertedName, std::u16string(newName.begin(), newName.end()));
     // Any characters sharing the same name will get replaced with the new name as of now
-    util::ReplaceAll<u8>(data, NameSection.bytesFrom(data), convertedName);
+    replacer.add(NameSection.bytesFrom(data), convertedName);
+}
+
+SlotInventoryIndex &Slot::inventoryIndex(SaveSpan data) const {
+    if (!inventory)
+        inventory.emplace(SlotSection.bytesFrom(data));
+    return *inventory;
+}
+
+void Slot::invalidateInventory() const {
+    inventory.reset();
+}
+
+bool Slot::checksumMatches(SaveSpan data, const util::Md5Hash &hash) const {
+    return std::ranges::equal(hash, SlotChecksumSection.bytesFrom(data));
+}
+
+bool Slot::overlapsData(Section section) const {
+    return SlotSection.overlaps(section);
 }
 
 u32 Slot::getItemQuantity(SaveSpan data, Items::Item item) const {
     auto slot{SlotSection.bytesFrom(data)};
-    const auto itr{std::search(slot.begin(), slot.end(), item.data.begin(), item.data.end())};
-    return (itr != slot.end()) ? slot[itr - slot.begin() + item.data.size()] : 0;
+    const auto offset{inventoryIndex(data).find(item)};
+    return offset ? slot[*offset + item.data.size()] : 0;
 }
 
-void Slot::setItemQuantity(SaveSpan data, Items::Item item, u32 quantity) const {
-    constexpr static auto itemSize{10};
+Section Slot::setItemQuantity(SaveSpan data, Items::Item item, u32 quantity) const {
     auto slot{SlotSection.bytesFrom(data)};
+    auto &index{inventoryIndex(data)};
     size_t quantityOffset{};
+    size_t firstModified{};
 
-    if (auto itr = std::search(slot.begin(), slot.end(), item.data.begin(), item.data.end()); itr != slot.end())
+    if (const auto offset{index.find(item)})
         // If the item is already present we can just update the quantity
-        quantityOffset = (itr - slot.begin()) + item.data.size();
-    else {
-        // Otherwise we need to insert it. This currently works, but only for a few items.
-        for (size_t i{}; i < slot.size(); i++) {
-            // Check if an item exists at the current position
-            if (slot[i] == Items::ItemDelimiter.front() && slot[i + 1] == Items::ItemDelimiter.back()) {
-                const auto nextItem{i + itemSize};
-                const auto nextItemEnd{i + (itemSize * 2)};
-                // Check if the space after the found item is empty
-                if (std::search_n(slot.begin() + nextItem, slot.begin() + nextItemEnd, itemSize, 0x0) != slot.begin() + nextItemEnd) {
-                    // If yes, copy the requested item into it
-                    std::copy(item.data.begin(), item.data.end(), slot.begin() + nextItem);
-                    quantityOffset = nextItem + item.data.size();
-                    break;
-                } else
-                    i += itemSize;
-            }
-        }
+        firstModified = quantityOffset = *offset + item.data.size();
+    else if (const auto emptyRecord{index.takeEmptyRecord(slot)}) {
+        // Otherwise it is inserted into the first empty record following another one. This currently works, but only for a few items.
+        index.write(slot, *emptyRecord, item.data);
+        firstModified = *emptyRecord;
+        quantityOffset = *emptyRecord + item.data.size();
     }
 
     if (!quantityOffset)
         throw exception("Could not find a place for item with quantity {}", quantity);
-    slot[quantityOffset] = static_cast<u8>(quantity);
+    const std::array<u8, 1> quantityData{static_cast<u8>(quantity)};
+    index.write(slot, quantityOffset, quantityData);
+    return Section{SlotSection.address + firstModified, quantityOffset + quantityData.size() - firstModified};
+}
+
+bool Slot::active(SaveSpan data) const {
+    if (!cachedActive)
+        cachedActive = isActive(data, index);
+    return *cachedActive;
+}
+
+u64 Slot::level(SaveSpan data) const {
+    if (!cachedLevel)
+        cachedLevel = getLevel(data);
+    return *cachedLevel;
+}
+
+const std::string &Slot::name(SaveSpan data) const {
+    if (!cachedName)
+        cachedName = getName(data);
+    return *cachedName;
+}
+
+std::span<u8> Slot::rawName(SaveSpan data) const {
+    return NameSection.bytesFrom(data);
+}
+
+const std::string &Slot::timePlayed(SaveSpan data) const {
+    if (!cachedTimePlayed)
+        cachedTimePlayed = getTimePlayed(data);
+    return *cachedTimePlayed;
+}
+
+void Slot::invalidateMetadata(Section section) const {
+    if (Section{ActiveSection.address + index, 1}.overlaps(section))
+        cachedActive.reset();
+    if (LevelSection.overlaps(section))
+        cachedLevel.reset();
+    if (NameSection.overlaps(section))
+        cachedName.reset();
+    if (SecondsPlayedSection.overlaps(section))
+        cachedTimePlayed.reset();
 }
 
 std::string Slot::getName(SaveSpan data) const {
     return util::Utf16ToUtf8String(NameSection.bytesFrom(data));
 }
 
-void Slot::setActive(SaveSpan data, bool value) const {
+Section Slot::setActive(SaveSpan data, bool value) const {
     ActiveSection.bytesFrom(data)[index] = value;
+    return Section{ActiveSection.address + index, 1};
 }
 
 std::string Slot::getTimePlayed(SaveSpan data) const {
@@ -142,6 +203,7 @@ bool Slot::isActive(SaveSpan data, size_t slotIndex) const {
 }
 
 void SaveFile::validateData(SaveSpan data, std::string_view target) const {
+    Profiler::ScopedTimer timer{Profiler::Phase::Validate, HeaderBNDSection.size};
     if (HeaderBNDSection.stringFrom(data) != "BND" || data.size_bytes() != SaveFileSize)
         throw exception("{} is not a valid Elden Ring save file.", target);
 }
@@ -151,56 +213,202 @@ u64 SaveFile::steamId() const {
 }
 
 void SaveFile::debugListItems(int slotIndex) {
+    requireLoaded(slots[slotIndex].SlotSection);
     slots[slotIndex].debugListItems(saveData);
 }
 
-std::vector<u8> SaveFile::loadFile(std::filesystem::path path) const {
-    std::ifstream file(path, std::ios::in | std::ios::binary);
-    std::vector<u8> buffer;
-    if (!std::filesystem::exists(path))
-        throw exception("Path {} does not exist.", util::ToAbsolutePath(path).generic_string());
-    if (!file.is_open())
-        throw exception("Could not open file '{}'", util::ToAbsolutePath(path).generic_string());
+SaveFile::SaveFile(std::filesystem::path path, std::vector<Section> sections)
+    : saveDataContainer{path, [&sections]() {
+                            sections.push_back(HeaderBNDSection); // Needed for validation
+                            return sections;
+                        }()},
+      saveData{loadFile(path)}, loadedSections{std::move(sections)}, sourcePath{path}, sourceWriteTime{std::filesystem::last_write_time(path)}, slots{parseSlots()} {
+    validateData(saveData, util::ToAbsolutePath(path).generic_string());
+}
 
-    buffer = {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
-    file.close();
-    return buffer;
+std::vector<Section> SaveFile::SummarySections() {
+    std::vector<Section> sections{SteamIdSection, Slot::ActiveSection};
+    for (size_t itr{}; itr < SlotCount; itr++)
+        sections.push_back(Slot{itr}.SlotHeaderSection);
+    return sections;
 }
 
-void SaveFile::write(SaveSpan data, std::filesystem::path path) const {
-    // TODO: Seems like this messes up slot names sometimes? Probably encoding related
-    std::ofstream file(path, std::ios::out | std::ios::binary);
-    if (!std::filesystem::exists(path))
-        throw exception("Path {} does not exist.", util::ToAbsolutePath(path).generic_string());
-    if (!file.is_open())
-        throw exception("Could not open file '{}'", util::ToAbsolutePath(path).generic_string());
+std::vector<Section> SaveFile::SlotSections(size_t slotIndex) {
+    if (slotIndex >= SlotCount)
+        throw exception("Invalid slot index {}", slotIndex);
+    const Slot slot{slotIndex};
+    return {SteamIdSection, Slot::ActiveSection, slot.SlotHeaderSection, slot.SlotChecksumSection, slot.SlotSection};
+}
+
+bool SaveFile::IsSaveFile(const std::filesystem::path &path) {
+    const auto descriptor{open(path.c_str(), O_RDONLY)};
+    if (descriptor == -1)
+        return false;
+
+    struct stat status {};
+    std::array<char, HeaderBNDSection.size> magic{};
+    const auto valid{fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) && static_cast<size_t>(status.st_size) == SaveFileSize && pread(descriptor, magic.data(), magic.size(), HeaderBNDSection.address) == static_cast<ssize_t>(magic.size()) && std::string_view{magic.data(), magic.size()} == "BND"};
+    close(descriptor);
+    return valid;
+}
+
+void SaveFile::requireLoaded(Section section) const {
+    if (loadedSections.empty())
+        return;
+    for (const auto &loaded : loadedSections)
+        if (section.address >= loaded.address && section.length <= loaded.length)
+            return;
+    throw exception("The savefile '{}' was only partially loaded, {} is missing", util::ToAbsolutePath(sourcePath).generic_string(), section.size == SaveFileSize ? "the rest of the file" : DescribeSection(section));
+}
 
+SaveSpan SaveFile::loadFile(std::filesystem::path path) {
+    const auto data{saveDataContainer.data()};
+    if (data.size_bytes() != SaveFileSize)
+        throw exception("{} is not a valid Elden Ring save file.", util::ToAbsolutePath(path).generic_string());
+    return SaveSpan{data.data(), SaveFileSize};
+}
+
+void SaveFile::write(SaveSpan data, std::filesystem::path path) {
     validateData(data, "Generated data");
     recalculateChecksums(data);
+
+    std::error_code error;
+    const auto targetsSource{std::filesystem::equivalent(path, sourcePath, error)};
+    if (targetsSource && canWriteInPlace(path))
+        writeModified(data, path);
+    else
+        writeFull(data, path);
+
+    // Other targets do not change the source file, it still differs from the save data in the same ranges
+    if (targetsSource) {
+        modifiedSections.clear();
+        sourceWriteTime = std::filesystem::last_write_time(path);
+    }
+}
+
+bool SaveFile::canWriteInPlace(const std::filesystem::path &path) const {
+    std::error_code error;
+    if (!std::filesystem::equivalent(path, sourcePath, error) || error)
+        return false;
+    return std::filesystem::file_size(path, error) == SaveFileSize && std::filesystem::last_write_time(path, error) == sourceWriteTime && !error;
+}
+
+std::vector<Section> SaveFile::mergedModifiedSections() const {
+    auto sections{modifiedSections};
+    std::sort(sections.begin(), sections.end(), [](const Section &a, const Section &b) {
+        return a.address < b.address;
+    });
+
+    std::vector<Section> merged;
+    for (const auto &section : sections) {
+        if (!merged.empty() && section.address <= merged.back().length) {
+            const auto &last{merged.back()};
+            merged.back() = Section{last.address, std::max(last.length, section.length) - last.address};
+        } else
+            merged.push_back(section);
+    }
+    return merged;
+}
+
+void SaveFile::writeModified(SaveSpan data, const std::filesystem::path &path) {
+    Profiler::ScopedTimer timer{Profiler::Phase::Write};
+    const auto descriptor{open(path.c_str(), O_WRONLY)};
+    if (descriptor == -1)
+        throw exception("Could not open file '{}'", util::ToAbsolutePath(path).generic_string());
+
+    for (const auto &section : mergedModifiedSections()) {
+        const auto bytes{section.bytesFrom(data)};
+        for (size_t written{}; written < bytes.size();) {
+            const auto result{pwrite(descriptor, bytes.data() + written, bytes.size() - written, static_cast<off_t>(section.address + written))};
+            if (result == -1) {
+                close(descriptor);
+                throw exception("Could not write to file '{}'", util::ToAbsolutePath(path).generic_string());
+            }
+            written += static_cast<size_t>(result);
+        }
+        timer.addBytes(bytes.size());
+    }
+
+#ifdef __APPLE__
+    const auto synced{fsync(descriptor) == 0};
+#else
+    const auto synced{fdatasync(descriptor) == 0};
+#endif
+    close(descriptor);
+    if (!synced)
+        throw exception("Could not sync file '{}'", util::ToAbsolutePath(path).generic_string());
+}
+
+void SaveFile::writeFull(SaveSpan data, const std::filesystem::path &path) const {
+    Profiler::ScopedTimer timer{Profiler::Phase::Write, data.size_bytes()};
+    // The save data might be mapped from the target file, truncating it would invalidate the pages we have not modified.
+    // Writing to a temporary file and renaming it over the target keeps the mapped file intact.
+    std::filesystem::path temporaryPath{path};
+    temporaryPath += ".tmp";
+    std::ofstream file(temporaryPath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        throw exception("Could not open file '{}'", util::ToAbsolutePath(temporaryPath).generic_string());
+
     file.write(reinterpret_cast<const char *>(data.data()), data.size_bytes());
+    file.close();
+    if (!file)
+        throw exception("Could not write to file '{}'", util::ToAbsolutePath(temporaryPath).generic_string());
+
+    if (std::filesystem::exists(path))
+        std::filesystem::permissions(temporaryPath, std::filesystem::status(path).permissions());
+    std::filesystem::rename(temporaryPath, path);
 }
 
-const std::vector<Slot> SaveFile::parseSlots(SaveSpan data) const {
+const std::vector<Slot> SaveFile::parseSlots() const {
+    Profiler::ScopedTimer timer{Profiler::Phase::ParseSlots};
     std::vector<Slot> buffer;
     for (size_t i{}; i < SlotCount; i++)
-        buffer.push_back(Slot{data, i});
+        buffer.push_back(Slot{i});
 
     return buffer;
 }
 
-void SaveFile::refreshSlots() {
-    auto newSlots{parseSlots(saveData)};
-    slots.swap(newSlots);
+void SaveFile::markModified(Section section, bool invalidateInventories) {
+    modifiedSections.push_back(section);
+    occurrences.invalidate(section);
+    if (SaveHeaderSection.overlaps(section))
+        staleHeaderChecksum = true;
+    for (const auto &slot : slots) {
+        slot.invalidateMetadata(section);
+        if (slot.overlapsData(section)) {
+            staleSlotChecksums[slot.index] = true;
+            if (invalidateInventories)
+                slot.invalidateInventory();
+        }
+    }
+}
+
+void SaveFile::replace(Replacer replacer) {
+    if (!replacer.indexedBy(occurrences)) {
+        // These are what gets replaced when copying, renaming or changing the Steam ID, so later replacements only rescan the modified ranges
+        replacer.watch(SteamIdSection.bytesFrom(saveData));
+        for (const auto &slot : slots)
+            if (slot.active(saveData))
+                replacer.watch(slot.rawName(saveData));
+    }
+
+    for (const auto section : replacer.apply(saveData, &occurrences))
+        markModified(section);
 }
 
 void SaveFile::copySlot(SaveFile &source, size_t sourceSlotIndex, size_t targetSlotIndex) {
     if (targetSlotIndex > SlotCount || sourceSlotIndex > SlotCount)
         throw exception("Invalid slot index while copying character");
-
-    source.slots[sourceSlotIndex].copy(source.saveData, saveData, targetSlotIndex);
+    const auto &sourceSlot{source.slots[sourceSlotIndex]};
+    for (const auto section : {sourceSlot.SlotSection, sourceSlot.SlotChecksumSection, sourceSlot.SlotHeaderSection, SteamIdSection})
+        source.requireLoaded(section);
+
+    for (const auto section : source.slots[sourceSlotIndex].copy(source.saveData, saveData, targetSlotIndex))
+        markModified(section);
+    // The checksum is copied along with the slot, so it is still valid unless the source was modified
+    staleSlotChecksums[targetSlotIndex] = source.staleSlotChecksums[sourceSlotIndex];
     replaceSteamId(source.saveData, steamId());
     setSlotActivity(targetSlotIndex, true);
-    refreshSlots();
 }
 
 void SaveFile::copySlot(size_t sourceSlotIndex, size_t targetSlotIndex) {
@@ -210,7 +418,7 @@ void SaveFile::copySlot(size_t sourceSlotIndex, size_t targetSlotIndex) {
 void SaveFile::appendSlot(SaveFile &source, size_t sourceSlotIndex) {
     size_t firstAvailableSlot{SlotCount + 1};
     for (auto &slot : slots)
-        if (!slot.active) {
+        if (!slot.active(saveData)) {
             firstAvailableSlot = slot.index;
             break;
         }
@@ -229,58 +437,235 @@ void SaveFile::renameSlot(size_t slotIndex, std::string_view name) {
     if (slotIndex > SlotCount)
         throw exception("Invalid slot index while renaming character");
 
-    slots[slotIndex].rename(saveData, name);
-    refreshSlots();
+    Replacer replacer;
+    slots[slotIndex].rename(saveData, name, replacer);
+    replace(std::move(replacer));
 }
 
-void SaveFile::replaceSteamId(SaveSpan replaceFrom, u64 newSteamId) const {
+void SaveFile::replaceSteamId(SaveSpan replaceFrom, u64 newSteamId) {
     std::array<u8, sizeof(u64)> steamIdData{};
     std::memcpy(steamIdData.data(), &newSteamId, sizeof(u64));
-    util::ReplaceAll<u8>(saveData, SteamIdSection.bytesFrom(replaceFrom), steamIdData);
+    replace(Replacer{}.add(SteamIdSection.bytesFrom(replaceFrom), steamIdData));
 }
 
-void SaveFile::replaceSteamId(u64 newSteamId) const {
+void SaveFile::replaceSteamId(u64 newSteamId) {
     replaceSteamId(saveData, newSteamId);
 }
 
-void SaveFile::recalculateChecksums(SaveSpan data) const {
-    auto saveHeaderChecksum{util::GenerateMd5(SaveHeaderSection.bytesFrom(data))};
-    SaveHeaderChecksumSection.replace(data, saveHeaderChecksum);
-    for (auto &slot : slots)
-        slot.recalculateSlotChecksum(data);
+std::vector<util::Md5Hash> SaveFile::hashRegions(SaveSpan data, const std::vector<size_t> &regions) const {
+    std::vector<util::Md5Hash> hashes(regions.size());
+    if (regions.empty())
+        return hashes;
+
+    // Regions are dealt out round robin, so the smaller save header does not leave one thread with less work
+    const auto groups{std::clamp<size_t>(checksumThreads, 1, regions.size())};
+    util::ParallelFor(groups, groups, [this, data, &regions, &hashes, groups](size_t group) {
+        std::vector<size_t> members;
+        std::vector<std::span<const u8>> inputs;
+        for (size_t region{group}; region < regions.size(); region += groups) {
+            members.push_back(region);
+            inputs.push_back(regions[region] == 0 ? SaveHeaderSection.bytesFrom(data) : slots[regions[region] - 1].checksummedData(data));
+        }
+
+        const auto groupHashes{util::GenerateMd5(inputs)};
+        for (size_t itr{}; itr < members.size(); itr++)
+            hashes[members[itr]] = groupHashes[itr];
+    });
+    return hashes;
+}
+
+void SaveFile::recalculateChecksums(SaveSpan data) {
+    std::vector<size_t> regions;
+    if (staleHeaderChecksum)
+        regions.push_back(0);
+    for (const auto &slot : slots)
+        if (staleSlotChecksums[slot.index])
+            regions.push_back(slot.index + 1);
+
+    const auto hashes{hashRegions(data, regions)};
+    for (size_t itr{}; itr < regions.size(); itr++) {
+        if (regions[itr] == 0) {
+            SaveHeaderChecksumSection.replace(data, hashes[itr]);
+            markModified(SaveHeaderChecksumSection, false);
+        } else
+            markModified(slots[regions[itr] - 1].setChecksum(data, hashes[itr]), false);
+    }
+    staleHeaderChecksum = false;
+    staleSlotChecksums.fill(false);
+}
+
+ChecksumReport SaveFile::verifyChecksums() const {
+    requireLoaded(Section{0, SaveFileSize});
+    std::vector<size_t> regions(slots.size() + 1);
+    for (size_t itr{}; itr < regions.size(); itr++)
+        regions[itr] = itr;
+    const auto hashes{hashRegions(saveData, regions)};
+
+    ChecksumReport report{std::ranges::equal(hashes.front(), SaveHeaderChecksumSection.bytesFrom(saveData))};
+    for (const auto &slot : slots)
+        if (!slot.checksumMatches(saveData, hashes[slot.index + 1]))
+            report.corruptSlots.push_back(slot.index);
+    return report;
+}
+
+ChecksumReport SaveFile::VerifyFile(const std::filesystem::path &path) {
+    const auto target{util::ToAbsolutePath(path).generic_string()};
+    if (!std::filesystem::exists(path))
+        throw exception("Path {} does not exist.", target);
+    if (std::filesystem::file_size(path) != SaveFileSize)
+        throw exception("{} is not a valid Elden Ring save file.", target);
+
+    // The first group holds everything but the hashed regions. Every other group holds the next chunk of each region, so the regions are hashed side by side
+    std::vector<Section> regions{SaveHeaderSection};
+    std::vector<std::vector<Section>> groups{{HeaderBNDSection, SaveHeaderChecksumSection}};
+    for (size_t itr{}; itr < SlotCount; itr++) {
+        const Slot slot{itr};
+        regions.push_back(slot.SlotSection);
+        groups.front().push_back(slot.SlotChecksumSection);
+    }
+    size_t longest{};
+    for (const auto &region : regions)
+        longest = std::max(longest, region.size);
+    for (size_t offset{}; offset < longest; offset += VerifyChunkSize) {
+        auto &group{groups.emplace_back()};
+        for (const auto &region : regions) {
+            const auto start{std::min(offset, region.size)};
+            group.emplace_back(region.address + start, std::min(VerifyChunkSize, region.size - start));
+        }
+    }
+
+    std::vector<util::Md5Hash> stored(regions.size());
+    Md5::Streams streams{regions.size()};
+    util::StreamFile(path, groups, VerifyGroupCount, [&groups, &stored, &streams, &target](size_t group, std::span<const u8> data) {
+        if (group == 0) {
+            if (std::string_view{reinterpret_cast<const char *>(data.data()), HeaderBNDSection.size} != "BND")
+                throw exception("{} is not a valid Elden Ring save file.", target);
+            for (size_t itr{}; itr < stored.size(); itr++)
+                std::copy_n(data.begin() + HeaderBNDSection.size + itr * sizeof(util::Md5Hash), sizeof(util::Md5Hash), stored[itr].begin());
+            return;
+        }
+
+        std::vector<std::span<const u8>> pieces;
+        for (const auto &section : groups[group]) {
+            pieces.push_back(data.first(section.size));
+            data = data.subspan(section.size);
+        }
+        streams.update(pieces);
+    });
+
+    const auto hashes{streams.finish()};
+    ChecksumReport report{hashes.front() == stored.front()};
+    for (size_t itr{}; itr < SlotCount; itr++)
+        if (hashes[itr + 1] != stored[itr + 1])
+            report.corruptSlots.push_back(itr);
+    return report;
+}
+
+Patch SaveFile::diff(const SaveFile &target) const {
+    requireLoaded(Section{0, SaveFileSize});
+    target.requireLoaded(Section{0, SaveFileSize});
+    // Checksums are left out, they are recalculated for every slot a patch changes when it is written
+    std::vector<Section> checksums{SaveHeaderChecksumSection};
+    for (const auto &slot : slots)
+        checksums.push_back(slot.SlotChecksumSection);
+    // Changes are split where a named part starts or ends, so each one can be described by the part it lies in
+    std::vector<size_t> boundaries;
+    for (const auto &named : NamedSections()) {
+        boundaries.push_back(named.section.address);
+        boundaries.push_back(named.section.length);
+    }
+    return Patch::Diff(saveData, target.saveData, checksums, boundaries);
+}
+
+void SaveFile::applyPatch(const Patch &patch) {
+    requireLoaded(Section{0, SaveFileSize});
+    for (const auto &section : patch.apply(saveData))
+        markModified(section);
+}
+
+std::vector<SaveFile::NamedSection> SaveFile::NamedSections() {
+    std::vector<NamedSection> named{{HeaderBNDSection, "BND magic", true}, {SaveHeaderChecksumSection, "save header checksum", true}, {SteamIdSection, "Steam ID", false}, {Slot::ActiveSection, "active flags", false}};
+    const auto addSlots{[&named](std::string_view part, bool outermost, const auto &member) {
+        for (size_t itr{}; itr < SlotCount; itr++)
+            named.push_back({Slot{itr}.*member, fmt::format("slot {} {}", itr, part), outermost});
+    }};
+    addSlots("checksum", true, &Slot::SlotChecksumSection);
+    addSlots("name", false, &Slot::NameSection);
+    addSlots("level", false, &Slot::LevelSection);
+    addSlots("seconds played", false, &Slot::SecondsPlayedSection);
+    addSlots("header", false, &Slot::SlotHeaderSection);
+    named.push_back({SaveHeaderSection, "save header", true});
+    addSlots("data", true, &Slot::SlotSection);
+    return named;
+}
+
+std::string SaveFile::DescribeSection(Section section) {
+    // The first named section containing the range is the most precise name
+    const auto named{NamedSections()};
+    for (const auto &[namedSection, name, outermost] : named)
+        if (namedSection.address <= section.address && section.length <= namedSection.length)
+            return section.address == namedSection.address ? name : fmt::format("{} +0x{:X}", name, section.address - namedSection.address);
+
+    std::vector<std::string_view> names;
+    for (const auto &[namedSection, name, outermost] : named)
+        if (outermost && namedSection.overlaps(section))
+            names.push_back(name);
+    return names.empty() ? "unknown" : fmt::format("{}", fmt::join(names, ", "));
+}
+
+std::vector<Section> SaveFile::BackupChunks() {
+    std::vector<size_t> boundaries{0};
+    for (const auto &checksum : ChecksumSections())
+        boundaries.push_back(checksum.address);
+    boundaries.push_back(SaveHeaderSection.length);
+    boundaries.push_back(SaveFileSize);
+
+    std::vector<Section> chunks;
+    for (size_t itr{1}; itr < boundaries.size(); itr++)
+        chunks.emplace_back(boundaries[itr - 1], boundaries[itr] - boundaries[itr - 1]);
+    return chunks;
+}
+
+std::vector<Section> SaveFile::ChecksumSections() {
+    std::vector<Section> sections;
+    for (size_t itr{}; itr < SlotCount; itr++)
+        sections.push_back(Slot{itr}.SlotChecksumSection);
+    sections.push_back(SaveHeaderChecksumSection);
+    return sections;
 }
 
 void SaveFile::setSlotActivity(size_t slotIndex, bool active) {
-    slots[slotIndex].setActive(saveData, active);
-    refreshSlots();
+    markModified(slots[slotIndex].setActive(saveData, active));
 }
 
 u32 SaveFile::getItem(size_t slot, Items::Item item) const {
+    requireLoaded(slots[slot].SlotSection);
     return slots[slot].getItemQuantity(saveData, item);
 }
 
-void SaveFile::setItem(size_t slot, Items::Item item, u32 quantity) const {
-    slots[slot].setItemQuantity(saveData, item, quantity);
+void SaveFile::setItem(size_t slot, Items::Item item, u32 quantity) {
+    requireLoaded(slots[slot].SlotSection);
+    markModified(slots[slot].setItemQuantity(saveData, item, quantity), false);
 }
 
 void SaveFile::printActiveSlots() const {
-    for (auto slot : slots)
-        if (slot.active)
+    for (const auto &slot : slots)
+        if (slot.active(saveData))
             printSlot(slot.index);
 }
 
 void SaveFile::printSlot(size_t slotIndex) const {
-    const auto slot{slots[slotIndex]};
-    if (!slot.active)
+    const auto &slot{slots[slotIndex]};
+    if (!slot.active(saveData))
         fmt::print("warning: slot {} is not active\n", slotIndex);
-    fmt::print("slot {}: {}, level {}, played for {}\n", slotIndex, slot.name, slot.level, slot.timePlayed);
+    fmt::print("slot {}: {}, level {}, played for {}\n", slotIndex, slot.name(saveData), slot.level(saveData), slot.timePlayed(saveData));
 }
 
 void SaveFile::printItems(size_t slotIndex) const {
-    const auto slot{slots[slotIndex]};
-    if (!slot.active)
+    const auto &slot{slots[slotIndex]};
+    if (!slot.active(saveData))
         fmt::print("warning: slot {} is not active\n", slotIndex);
-    for (auto item : items)
-        if (getItem(slotIndex, item.second))
-            fmt::print("{}: {}\n", item.first, getItem(slotIndex, item.second));
+    for (const auto &item : items)
+        if (const auto quantity{getItem(slotIndex, item)})
+            fmt::print("{}: {}\n", item.name, quantity);
 }
@@ -1,5 +1,10 @@
+#pragma once
+#include "inventory.h"
 #include "items.h"
+#include "patch.h"
+#include "replacer.h"
 #include <filesystem>
+#include <optional>
 #include <span>
 #include <vector>
 #include <string>
@@ -12,29 +17,36 @@ using SaveSpan = std::span<u8, SaveFileSize>;     //!< A span of the save file
  * @brief One of the slots in a save file
  */
 class Slot {
+    friend class SaveFile;           //!< Streams the regions of a slot when verifying a file without loading it
+    friend class Watcher;            //!< Reads only the sections of a slot that changed when the game writes a watched file
+    friend struct SaveFileGenerator; //!< Fills in the sections of generated save files
+
   public:
-    const size_t index; //!< The index of the save slot, each character has a unique slot. This value can range between 0-9
+    const size_t index;                                  //!< The index of the save slot, each character has a unique slot. This value can range between 0-9
+    constexpr static const size_t NameSectionSize{0x22}; //!< The size of a characters name in bytes
   private:
     /**
      * @brief Used to calculate a target address when copying a character
      */
     constexpr static const size_t SlotSectionOffset{0x310};
+    constexpr static const size_t SlotChecksumSectionOffset{0x300};
     constexpr static const size_t SlotHeaderSectionOffset{0x1901D0E};
-    constexpr static const size_t NameSectionSize{0x22};
+    constexpr static const size_t SlotSectionSize{0x280000};
+    constexpr static const size_t SlotHeaderSectionSize{0x24C};
 
-    constexpr static Section ActiveSection{0x1901D04, 0xA};                       //!< Contains booleans indicating if the character at address + slotIndex is active
-    const Section SlotSection{ParseSlot(SlotSectionOffset, 0x280000)};            //!< Contains the save data of the character
-    const Section SlotChecksumSection{ParseSlot(0x300, 0x10)};                    //!< Contains the checksum of the data section
-    const Section SlotHeaderSection{ParseHeader(SlotHeaderSectionOffset, 0x24C)}; //!< Contains the slots header
-    const Section NameSection{ParseHeader(0x1901D0E, NameSectionSize)};           //!< Contains the name of a character, without slot index parsing
-    const Section LevelSection{ParseHeader(0x1901D30, 0x1)};                      //!< Contains the level of the character
-    const Section SecondsPlayedSection{ParseHeader(0x1901D34, 0x4)};              //!< Contains the number of seconds played
+    constexpr static Section ActiveSection{0x1901D04, 0xA};                                       //!< Contains booleans indicating if the character at address + slotIndex is active
+    const Section SlotSection{ParseSlot(SlotSectionOffset, SlotSectionSize)};                     //!< Contains the save data of the character
+    const Section SlotChecksumSection{ParseSlot(SlotChecksumSectionOffset, 0x10)};                //!< Contains the checksum of the data section
+    const Section SlotHeaderSection{ParseHeader(SlotHeaderSectionOffset, SlotHeaderSectionSize)}; //!< Contains the slots header
+    const Section NameSection{ParseHeader(0x1901D0E, NameSectionSize)};                           //!< Contains the name of a character, without slot index parsing
+    const Section LevelSection{ParseHeader(0x1901D30, 0x1)};                                      //!< Contains the level of the character
+    const Section SecondsPlayedSection{ParseHeader(0x1901D34, 0x4)};                              //!< Contains the number of seconds played
 
     /**
      * @brief A wrapper around Section that provides the offsets for a save header
      */
     constexpr Section ParseHeader(size_t address, size_t size, size_t slotIndex) const {
-        return Section{address + (slotIndex * SlotHeaderSection.size), size};
+        return Section{address + (slotIndex * SlotHeaderSectionSize), size};
     }
 
     constexpr Section ParseHeader(size_t address, size_t size) const {
@@ -45,13 +57,26 @@ class Slot {
      * @brief A wrapper around Section that provides the offsets for a save slot
      */
     constexpr Section ParseSlot(size_t address, size_t size, size_t slotIndex) const {
-        return Section{address + (slotIndex * 0x10) + (slotIndex * SlotSection.size), size};
+        return Section{address + (slotIndex * 0x10) + (slotIndex * SlotSectionSize), size};
     }
 
     constexpr Section ParseSlot(size_t address, size_t size) const {
         return ParseSlot(address, size, index);
     }
 
+    mutable std::optional<SlotInventoryIndex> inventory; //!< A lazily built index of the items in this slot
+
+    // The metadata is decoded on first access and cached until the range it is decoded from is modified
+    mutable std::optional<bool> cachedActive;
+    mutable std::optional<u64> cachedLevel;
+    mutable std::optional<std::string> cachedName;
+    mutable std::optional<std::string> cachedTimePlayed;
+
+    /**
+     * @brief Get the inventory index of this slot, building it if it is not cached yet
+     */
+    SlotInventoryIndex &inventoryIndex(SaveSpan data) const;
+
     bool isActive(SaveSpan data, size_t slotIndex) const;
 
     std::string getName(SaveSpan data) const;
@@ -61,25 +86,72 @@ class Slot {
     u64 getLevel(SaveSpan data) const;
 
   public:
-    bool active;            //!< Whether the save slot is currently in use
-    u64 level;              //!< The level of the character
-    std::string name;       //!< The name of the character
-    std::string timePlayed; //!< A timestamp of the characters play time
+    Slot(size_t slotIndex) : index{slotIndex} {}
+
+    /**
+     * @brief Whether the save slot is currently in use
+     */
+    bool active(SaveSpan data) const;
+
+    /**
+     * @brief The level of the character
+     */
+    u64 level(SaveSpan data) const;
 
-    constexpr Slot(SaveSpan data, size_t slotIndex) : index{slotIndex}, active{isActive(data, slotIndex)}, level{getLevel(data)}, name{getName(data)}, timePlayed{getTimePlayed(data)} {}
+    /**
+     * @brief The name of the character
+     */
+    const std::string &name(SaveSpan data) const;
 
     /**
-     * @brief Copy the currently active save slot into the given span
+     * @brief The name of the character as it is stored, in UTF-16
+     */
+    std::span<u8> rawName(SaveSpan data) const;
+
+    /**
+     * @brief A timestamp of the characters play time
+     */
+    const std::string &timePlayed(SaveSpan data) const;
+
+    /**
+     * @brief Drop the cached inventory index, for when the data of this slot was modified without going through it
+     */
+    void invalidateInventory() const;
+
+    /**
+     * @brief Drop the cached metadata that is decoded from the given range, if any
+     */
+    void invalidateMetadata(Section section) const;
+
+    /**
+     * @brief Check if a range of the save file overlaps with the data of this slot, which is covered by its checksum
+     */
+    bool overlapsData(Section section) const;
+
+    /**
+     * @brief Copy the currently active save slot into the given span, including its checksum
      * @param source The span to copy the save slot from
      * @param target The span to copy the save slot to
      * @param targetSlotIndex The index of the source save slot to copy
+     * @return The sections of the target that have been written to
      */
-    void copy(SaveSpan source, SaveSpan target, size_t targetSlotIndex) const;
+    std::array<Section, 3> copy(SaveSpan source, SaveSpan target, size_t targetSlotIndex) const;
 
     /**
-     * @brief Recalculate and replace the checksum of the currently active save slot
+     * @brief The data of the slot that is covered by its checksum
      */
-    void recalculateSlotChecksum(SaveSpan data) const;
+    std::span<u8> checksummedData(SaveSpan data) const;
+
+    /**
+     * @brief Replace the checksum of the slot with a hash of its data
+     * @return The section the checksum was written to
+     */
+    Section setChecksum(SaveSpan data, const util::Md5Hash &hash) const;
+
+    /**
+     * @brief Check if the stored checksum matches a hash of the data of the slot
+     */
+    bool checksumMatches(SaveSpan data, const util::Md5Hash &hash) const;
 
     /**
      * @brief List all items that could not yet be properly parsed
@@ -88,33 +160,107 @@ class Slot {
 
     u32 getItemQuantity(SaveSpan data, Items::Item item) const;
 
-    void setItemQuantity(SaveSpan data, Items::Item item, u32 quantity) const;
+    /**
+     * @return The section of the save file that has been written to
+     */
+    Section setItemQuantity(SaveSpan data, Items::Item item, u32 quantity) const;
 
-    void setActive(SaveSpan data, bool active) const;
+    /**
+     * @return The section of the save file that has been written to
+     */
+    Section setActive(SaveSpan data, bool active) const;
+
+    /**
+     * @brief Queue replacing all occurances of the current name with the new name
+     */
+    void rename(SaveSpan data, std::string_view newName, Replacer &replacer) const;
+};
+
+/**
+ * @brief The result of comparing the stored checksums of a save file against its data
+ */
+struct ChecksumReport {
+    bool headerValid{true};             //!< Whether the checksum of the save header matches
+    std::vector<size_t> corruptSlots{}; //!< The indices of all slots with a mismatching checksum
 
-    void rename(SaveSpan data, std::string_view newName) const;
+    bool valid() const {
+        return headerValid && corruptSlots.empty();
+    }
 };
 
 /**
  * @brief Elden Ring save file parser and patcher
  */
 class SaveFile {
+    friend struct SaveFileBenchmarks; //!< Times the private load, parse, checksum and write steps individually
+    friend class Watcher;             //!< Reads the sections of a watched file directly instead of loading it
+    friend struct SaveFileGenerator;  //!< Fills in the sections of generated save files
+
   private:
-    constexpr static size_t SlotCount{10}; //!< The number of slots in each save file starting from 0
-    std::vector<u8> saveDataContainer;
+    constexpr static size_t SlotCount{10};              //!< The number of slots in each save file starting from 0
+    constexpr static size_t VerifyChunkSize{64 * 1024}; //!< The amount of every hashed region VerifyFile reads at once, a multiple of the MD5 block size
+    constexpr static size_t VerifyGroupCount{3};        //!< The amount of chunk groups VerifyFile keeps in flight
+    util::FileBuffer saveDataContainer;
     SaveSpan saveData;
+    std::vector<Section> loadedSections;              //!< The ranges that were read from the file, empty if all of it was
+    std::vector<Section> modifiedSections;            //!< All ranges of the save data that differ from the file they were loaded from
+    std::array<bool, SlotCount> staleSlotChecksums{}; //!< Whether the data of a slot changed without its checksum being updated
+    bool staleHeaderChecksum{};                       //!< Whether the save header changed without its checksum being updated
+    const std::filesystem::path sourcePath;           //!< The file the save data was loaded from
+    std::filesystem::file_time_type sourceWriteTime;  //!< The modification time of the source file when we last read or wrote it
+    OccurrenceIndex occurrences;                      //!< Where the Steam ID and character names occur, so replacing them again only rescans modified ranges
 
     constexpr static Section HeaderBNDSection{0x0, 0x3};                 //!< Contains the characters BND, used for validation
     constexpr static Section SaveHeaderSection{0x19003B0, 0x60000};      //!< Contains the save header
     constexpr static Section SaveHeaderChecksumSection{0x19003A0, 0x10}; //!< Contains the MD5 sum of the save header
     constexpr static Section SteamIdSection{0x19003B4, 0x8};             //!< Contains one instance the Steam ID
 
-    std::vector<u8> loadFile(std::filesystem::path path) const;
+    /**
+     * @brief Get a span over the loaded contents of the file, which are memory mapped when possible
+     */
+    SaveSpan loadFile(std::filesystem::path path);
+
+    struct NamedSection {
+        Section section;
+        std::string name;
+        bool outermost; //!< Whether no other named section contains it
+    };
+
+    /**
+     * @brief Every part of a save file DescribeSection knows, ordered from the most specific to the most general
+     */
+    static std::vector<NamedSection> NamedSections();
+
+    /**
+     * @brief Throw if the save data was only partially loaded and does not contain the given range
+     */
+    void requireLoaded(Section section) const;
+
+    /**
+     * @brief Recalculate checksums and write the resulting span to a file
+     * @note If the target is the unchanged source file only the modified ranges are written, otherwise it is replaced atomically
+     */
+    void write(SaveSpan data, std::filesystem::path path);
+
+    /**
+     * @brief Check if the source file can be patched in place, which requires it to be unchanged since we last read or wrote it
+     */
+    bool canWriteInPlace(const std::filesystem::path &path) const;
+
+    /**
+     * @brief Write only the modified ranges of the save data to the file they were loaded from
+     */
+    void writeModified(SaveSpan data, const std::filesystem::path &path);
+
+    /**
+     * @brief Write all of the save data to a temporary file and rename it over the target
+     */
+    void writeFull(SaveSpan data, const std::filesystem::path &path) const;
 
     /**
-     * @brief Replace the Steam ID, recalculate checksums and write the resulting span to a file
+     * @brief Get the modified ranges sorted by address, with overlapping and adjacent ranges merged
      */
-    void write(SaveSpan data, std::filesystem::path path) const;
+    std::vector<Section> mergedModifiedSections() const;
 
     /**
      * @brief Validate a file is an Elden Ring save file
@@ -123,37 +269,135 @@ class SaveFile {
     void validateData(SaveSpan data, std::string_view target) const;
 
     /**
-     * @brief Recalculate and replace the save header and slot checksums
+     * @brief Recalculate and replace the checksums of the save header and all slots that have been modified
      */
-    void recalculateChecksums(SaveSpan data) const;
+    void recalculateChecksums(SaveSpan data);
+
+    /**
+     * @brief Hash the regions covered by checksums
+     * @param regions 0 is the save header, every other value is a slot index plus one
+     * @note Each thread hashes its share of the regions as a single multi-buffer batch, see checksumThreads
+     */
+    std::vector<util::Md5Hash> hashRegions(SaveSpan data, const std::vector<size_t> &regions) const;
 
     /**
      * @brief Replace the Steam ID inside the target save file
      * @param replaceFrom The data containing the Steam ID to replace
      */
-    void replaceSteamId(SaveSpan replaceFrom, u64 newSteamId) const;
+    void replaceSteamId(SaveSpan replaceFrom, u64 newSteamId);
 
-    const std::vector<Slot> parseSlots(SaveSpan data) const;
+    /**
+     * @brief Create all slots, their metadata is only decoded once it is accessed
+     */
+    const std::vector<Slot> parseSlots() const;
 
-    void refreshSlots();
+    /**
+     * @brief Keep track of a modified range of the save data, so only the checksums covering it get recalculated and only the slot metadata decoded from it is dropped
+     * @param invalidateInventories Whether to drop the inventory index of the slots overlapping the range, for writes that did not go through it
+     */
+    void markModified(Section section, bool invalidateInventories = true);
+
+    /**
+     * @brief Apply the replacements to the save data and mark the replaced ranges as modified
+     * @note If the save data has to be scanned, the Steam ID and the names of all active characters are indexed in the same pass
+     */
+    void replace(Replacer replacer);
 
   public:
     std::vector<Slot> slots; //!< The characters in the save file
     Items::Items items{};
+    size_t checksumThreads{util::DefaultThreadCount()}; //!< The amount of threads used to calculate checksums, 1 hashes everything on the calling thread
 
-    SaveFile(std::filesystem::path path) : saveDataContainer{loadFile(path)}, saveData{saveDataContainer}, slots{parseSlots(saveData)} {
+    /**
+     * @param map Whether the file is mapped instead of read into memory, see util::FileBuffer. Save files that stay loaded while other programs may write them should not be mapped
+     */
+    SaveFile(std::filesystem::path path, bool map = true) : saveDataContainer{path, map}, saveData{loadFile(path)}, sourcePath{path}, sourceWriteTime{std::filesystem::last_write_time(path)}, slots{parseSlots()} {
         validateData(saveData, util::ToAbsolutePath(path).generic_string());
     }
 
+    /**
+     * @brief Load only some ranges of a save file, every other byte reads as zero
+     * @note Anything that needs a range that was not loaded throws, and the save data can not be written. See SummarySections and SlotSections
+     */
+    SaveFile(std::filesystem::path path, std::vector<Section> sections);
+
+    /**
+     * @brief The ranges needed to print the Steam ID and all active slots
+     */
+    static std::vector<Section> SummarySections();
+
+    /**
+     * @brief The ranges needed to print, list the items of or import a single slot
+     */
+    static std::vector<Section> SlotSections(size_t slotIndex);
+
+    /**
+     * @brief Check if a file is an Elden Ring save file by its size and the first bytes of its header, without loading it
+     */
+    static bool IsSaveFile(const std::filesystem::path &path);
+
     void debugListItems(int slotIndex);
 
     /**
      * @brief Write the patched save data to a file
      */
     void write(std::filesystem::path path) {
+        requireLoaded(Section{0, SaveFileSize});
         write(saveData, path);
     }
 
+    /**
+     * @brief Whether the save data differs from the file it was loaded from
+     */
+    bool modified() const {
+        return !modifiedSections.empty();
+    }
+
+    /**
+     * @brief Whether the file the save data was loaded from was changed by another program since we last read or wrote it
+     */
+    bool sourceChanged() const {
+        return !canWriteInPlace(sourcePath);
+    }
+
+    /**
+     * @brief Compare the stored checksums of the save header and all slots against their data
+     */
+    ChecksumReport verifyChecksums() const;
+
+    /**
+     * @brief Compare the stored checksums of a save file against its data without loading it
+     * @note The file is read on a separate thread, a chunk of every region at a time, while the previous chunks are hashed side by side. Memory use stays at a few chunks per region
+     */
+    static ChecksumReport VerifyFile(const std::filesystem::path &path);
+
+    /**
+     * @brief Find the ranges in which another save file differs from this one, apart from the checksums
+     */
+    Patch diff(const SaveFile &target) const;
+
+    /**
+     * @brief Apply a patch created by diff, only the checksums of the slots it changes are recalculated when writing
+     */
+    void applyPatch(const Patch &patch);
+
+    /**
+     * @brief Name the part of a save file a range belongs to, like 'slot 2 name' or 'save header +0x1C'
+     * @note A range that spans several parts lists the outermost ones, like 'slot 0 data, slot 1 checksum'
+     */
+    static std::string DescribeSection(Section section);
+
+    /**
+     * @brief Split a save file into ranges that change independently of each other: every slot along with its checksum, the save header along with its checksum, and the rest
+     * @note The ranges are sorted and cover the whole file
+     */
+    static std::vector<Section> BackupChunks();
+
+    /**
+     * @brief The MD5 sums of every slot and the save header, each one starts the backup chunk it covers the rest of
+     */
+    static std::vector<Section> ChecksumSections();
+
     /**
      * @brief Copy a character from a source save file
      * @param source The save file to copy from
@@ -191,7 +435,7 @@ class SaveFile {
     /**
      * @brief Replace all occurances of the Steam ID
      */
-    void replaceSteamId(u64 newSteamId) const;
+    void replaceSteamId(u64 newSteamId);
 
     /**
      * @brief Get the quantity of an item in the given slot
@@ -201,7 +445,7 @@ class SaveFile {
     /**
      * @brief Set the quantity of an item in the given slot
      */
-    void setItem(size_t slot, Items::Item item, u32 quantity) const;
+    void setItem(size_t slot, Items::Item item, u32 quantity);
 
     void printActiveSlots() const;
 
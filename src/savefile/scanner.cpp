@@ -0,0 +1,130 @@
+#include "scanner.h"
+#include "items.h"
+#include <bit>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace Scanner {
+
+namespace {
+
+constexpr u8 First{Items::ItemDelimiter.front()};
+constexpr u8 Second{Items::ItemDelimiter.back()};
+
+/**
+ * @brief Scan the range [offset, data.size() - 1) one byte at a time, used for the tail of the vectorized kernels
+ */
+void ScanScalar(std::span<const u8> data, size_t offset, std::vector<u32> &result) {
+    for (; offset + 1 < data.size(); offset++)
+        if (data[offset] == First && data[offset + 1] == Second) [[unlikely]]
+            result.push_back(static_cast<u32>(offset));
+}
+
+/**
+ * @brief Append the offsets of all set bits in a comparison mask
+ */
+template <typename Mask> inline void AppendMask(Mask mask, size_t offset, std::vector<u32> &result) {
+    while (mask) {
+        result.push_back(static_cast<u32>(offset + std::countr_zero(mask)));
+        mask &= mask - 1;
+    }
+}
+
+#ifdef SCANNER_X86
+__attribute__((target("sse2"))) void ScanSse2(std::span<const u8> data, std::vector<u32> &result) {
+    constexpr static size_t Width{sizeof(__m128i)};
+    const auto first{_mm_set1_epi8(static_cast<char>(First))};
+    const auto second{_mm_set1_epi8(static_cast<char>(Second))};
+    size_t offset{};
+
+    // Compare every byte against the first delimiter byte, and the byte after it against the second
+    for (; offset + Width + 1 <= data.size(); offset += Width) {
+        const auto current{_mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + offset))};
+        const auto next{_mm_loadu_si128(reinterpret_cast<const __m128i *>(data.data() + offset + 1))};
+        const auto match{_mm_and_si128(_mm_cmpeq_epi8(current, first), _mm_cmpeq_epi8(next, second))};
+        AppendMask(static_cast<u32>(_mm_movemask_epi8(match)), offset, result);
+    }
+
+    ScanScalar(data, offset, result);
+}
+
+__attribute__((target("avx2"))) void ScanAvx2(std::span<const u8> data, std::vector<u32> &result) {
+    constexpr static size_t Width{sizeof(__m256i)};
+    const auto first{_mm256_set1_epi8(static_cast<char>(First))};
+    const auto second{_mm256_set1_epi8(static_cast<char>(Second))};
+    size_t offset{};
+
+    for (; offset + Width + 1 <= data.size(); offset += Width) {
+        const auto current{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data.data() + offset))};
+        const auto next{_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data.data() + offset + 1))};
+        const auto match{_mm256_and_si256(_mm256_cmpeq_epi8(current, first), _mm256_cmpeq_epi8(next, second))};
+        AppendMask(static_cast<u32>(_mm256_movemask_epi8(match)), offset, result);
+    }
+
+    ScanScalar(data, offset, result);
+}
+#endif
+
+using Kernel = void (*)(std::span<const u8>, std::vector<u32> &);
+
+struct NamedKernel {
+    std::string_view name;
+    Kernel kernel;
+};
+
+/**
+ * @brief All kernels this CPU supports, fastest first
+ */
+std::vector<NamedKernel> Supported() {
+    std::vector<NamedKernel> kernels;
+#ifdef SCANNER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        kernels.push_back({"avx2", ScanAvx2});
+    if (__builtin_cpu_supports("sse2"))
+        kernels.push_back({"sse2", ScanSse2});
+#endif
+    kernels.push_back({"scalar", [](std::span<const u8> data, std::vector<u32> &result) {
+                           ScanScalar(data, 0, result);
+                       }});
+    return kernels;
+}
+
+/**
+ * @brief The kernel FindDelimiters uses, selected once based on the features of the CPU we are running on
+ */
+Kernel &Selected() {
+    static auto kernel{Supported().front().kernel};
+    return kernel;
+}
+
+} // namespace
+
+std::vector<std::string_view> SupportedKernels() {
+    std::vector<std::string_view> names;
+    for (const auto &kernel : Supported())
+        names.push_back(kernel.name);
+    return names;
+}
+
+void UseKernel(std::string_view name) {
+    for (const auto &kernel : Supported())
+        if (kernel.name == name) {
+            Selected() = kernel.kernel;
+            return;
+        }
+    throw exception("The scan kernel '{}' is not supported by this CPU", name);
+}
+
+std::vector<u32> FindDelimiters(std::span<const u8> data) {
+    Profiler::ScopedTimer timer{Profiler::Phase::ItemScan, data.size_bytes()};
+    Profiler::CountSearch(data.size_bytes());
+    std::vector<u32> result;
+    Selected()(data, result);
+    return result;
+}
+
+} // namespace Scanner
@@ -0,0 +1,26 @@
+#pragma once
+#include "../util.h"
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace Scanner {
+
+/**
+ * @brief Find all occurances of Items::ItemDelimiter, using the widest vector instructions the CPU supports
+ * @return The offset of the first byte of every occurance, in ascending order
+ */
+std::vector<u32> FindDelimiters(std::span<const u8> data);
+
+/**
+ * @brief The names of all scan kernels this CPU supports, fastest first. The last one is the scalar loop
+ */
+std::vector<std::string_view> SupportedKernels();
+
+/**
+ * @brief Make FindDelimiters use the named kernel instead of the fastest one, so every kernel can be tested on the same CPU
+ * @note Not thread safe, only call this before scanning
+ */
+void UseKernel(std::string_view name);
+
+} // namespace Scanner
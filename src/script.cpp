@@ -0,0 +1,108 @@
+#include "script.h"
+#include <charconv>
+#include <fstream>
+#include <iostream>
+
+Script::Script(std::istream &stream, std::string_view name) : name{name} {
+    std::string line;
+    for (size_t lineNumber{1}; std::getline(stream, line); lineNumber++) {
+        auto arguments{tokenize(line, lineNumber)};
+        if (arguments.empty())
+            continue;
+
+        const auto command{arguments.front()};
+        arguments.erase(arguments.begin());
+        operations.push_back({command, std::move(arguments), lineNumber});
+    }
+}
+
+Script Script::FromFile(const std::filesystem::path &path) {
+    if (path == "-")
+        return Script{std::cin, "stdin"};
+
+    std::ifstream file(path);
+    if (!file.is_open())
+        throw exception("Could not open script '{}'", util::ToAbsolutePath(path).generic_string());
+    return Script{file, path.generic_string()};
+}
+
+std::vector<std::string> Script::tokenize(std::string_view line, size_t lineNumber) const {
+    std::vector<std::string> result;
+    std::string current;
+    bool quoted{};
+    bool hasToken{};
+
+    for (const auto character : line) {
+        if (character == '"') {
+            quoted = !quoted;
+            hasToken = true;
+        } else if (!quoted && character == '#')
+            break;
+        else if (!quoted && std::isspace(static_cast<unsigned char>(character))) {
+            if (hasToken)
+                result.push_back(std::move(current));
+            current.clear();
+            hasToken = false;
+        } else {
+            current += character;
+            hasToken = true;
+        }
+    }
+
+    if (quoted)
+        throw exception("{}:{}: Unterminated quote", name, lineNumber);
+    if (hasToken)
+        result.push_back(std::move(current));
+    return result;
+}
+
+template <typename Type> Type Script::toNumber(const Operation &operation, size_t argument) const {
+    const auto &value{operation.arguments.at(argument)};
+    Type result{};
+    const auto [end, error]{std::from_chars(value.data(), value.data() + value.size(), result)};
+    if (error != std::errc{} || end != value.data() + value.size())
+        throw exception("{}:{}: Invalid number '{}' for '{}'", name, operation.line, value, operation.command);
+    return result;
+}
+
+size_t Script::toSlot(const SaveFile &saveFile, const Operation &operation, size_t argument) const {
+    const auto slot{toNumber<size_t>(operation, argument)};
+    if (slot >= saveFile.slots.size())
+        throw exception("{}:{}: Invalid slot index {} for '{}'", name, operation.line, slot, operation.command);
+    return slot;
+}
+
+void Script::apply(SaveFile &saveFile, const Operation &operation, ImportedSaveFiles &imports) const {
+    const auto expectArguments{[this, &operation](size_t count) {
+        if (operation.arguments.size() != count)
+            throw exception("{}:{}: '{}' expects {} arguments, got {}", name, operation.line, operation.command, count, operation.arguments.size());
+    }};
+
+    if (operation.command == "set-item") {
+        expectArguments(3);
+        saveFile.setItem(toSlot(saveFile, operation, 0), saveFile.items[operation.arguments[1]], toNumber<u32>(operation, 2));
+    } else if (operation.command == "rename") {
+        expectArguments(2);
+        saveFile.renameSlot(toSlot(saveFile, operation, 0), operation.arguments[1]);
+    } else if (operation.command == "copy") {
+        expectArguments(2);
+        saveFile.copySlot(toSlot(saveFile, operation, 0), toSlot(saveFile, operation, 1));
+    } else if (operation.command == "import") {
+        expectArguments(3);
+        const auto &path{operation.arguments[0]};
+        if (!imports.contains(path))
+            imports.emplace(path, std::make_unique<SaveFile>(path));
+        auto &source{*imports.at(path)};
+        saveFile.copySlot(source, toSlot(source, operation, 1), toSlot(saveFile, operation, 2));
+    } else if (operation.command == "steam-id") {
+        expectArguments(1);
+        saveFile.replaceSteamId(toNumber<u64>(operation, 0));
+    } else
+        throw exception("{}:{}: Unknown operation '{}'", name, operation.line, operation.command);
+}
+
+void Script::run(SaveFile &saveFile) const {
+    ImportedSaveFiles imports;
+    for (const auto &operation : operations)
+        apply(saveFile, operation, imports);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "savefile/savefile.h"
+#include "util.h"
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A list of operations on a save file, which are all applied in a single pass
+ * @note Every line contains one operation, arguments are separated by spaces and can be quoted. Lines starting with '#' are ignored.
+ *
+ * set-item <slot> <item name> <amount>
+ * rename <slot> <new name>
+ * copy <source slot> <target slot>
+ * import <savefile> <source slot> <target slot>
+ * steam-id <Steam ID>
+ */
+class Script {
+  public:
+    struct Operation {
+        std::string command;
+        std::vector<std::string> arguments;
+        size_t line; //!< The line the operation was parsed from, used for error messages
+    };
+
+  private:
+    using ImportedSaveFiles = std::map<std::string, std::unique_ptr<SaveFile>>; //!< Save files loaded by 'import' operations, so each one is only loaded once per run
+
+    std::string name;                  //!< The name of the script, used for error messages
+    std::vector<Operation> operations; //!< All operations in the order they should be applied
+
+    /**
+     * @brief Split a line into its arguments
+     */
+    std::vector<std::string> tokenize(std::string_view line, size_t lineNumber) const;
+
+    /**
+     * @brief Convert an argument to a number, throwing an error with the location of the operation if it is invalid
+     */
+    template <typename Type> Type toNumber(const Operation &operation, size_t argument) const;
+
+    size_t toSlot(const SaveFile &saveFile, const Operation &operation, size_t argument) const;
+
+    void apply(SaveFile &saveFile, const Operation &operation, ImportedSaveFiles &imports) const;
+
+  public:
+    /**
+     * @param name The name of the script, used for error messages
+     */
+    Script(std::istream &stream, std::string_view name);
+
+    /**
+     * @brief Parse a script from a file, or from stdin if the path is '-'
+     */
+    static Script FromFile(const std::filesystem::path &path);
+
+    /**
+     * @brief Apply all operations to a save file
+     * @note A script can be run on multiple save files concurrently
+     */
+    void run(SaveFile &saveFile) const;
+
+    size_t size() const {
+        return operations.size();
+    }
+
+    auto begin() const {
+        return operations.begin();
+    }
+
+    auto end() const {
+        return operations.end();
+    }
+};
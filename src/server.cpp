@@ -0,0 +1,227 @@
+#include "server.h"
+#include "script.h"
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+volatile std::sig_atomic_t stopRequested{};
+
+void RequestStop(int) {
+    stopRequested = 1;
+}
+
+sockaddr_un SocketAddress(const std::filesystem::path &path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const auto &name{path.native()};
+    if (name.size() >= sizeof(address.sun_path))
+        throw exception("The socket path '{}' is longer than {} characters", name, sizeof(address.sun_path) - 1);
+    std::copy(name.begin(), name.end(), address.sun_path);
+    return address;
+}
+
+size_t ToNumber(std::string_view value) {
+    size_t result{};
+    const auto [end, error]{std::from_chars(value.data(), value.data() + value.size(), result)};
+    if (error != std::errc{} || end != value.data() + value.size())
+        throw exception("Invalid number '{}'", value);
+    return result;
+}
+
+} // namespace
+
+Server::Server(std::filesystem::path path) : socketPath{std::move(path)} {
+    const auto address{SocketAddress(socketPath)};
+
+    // A socket nobody accepts connections on is left over from a server that did not shut down cleanly
+    struct stat status {};
+    if (lstat(socketPath.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode))
+            throw exception("'{}' already exists and is not a socket", socketPath.generic_string());
+        const auto probe{socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)};
+        const auto inUse{probe != -1 && connect(probe, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0};
+        if (probe != -1)
+            close(probe);
+        if (inUse)
+            throw exception("Another server is already listening on '{}'", socketPath.generic_string());
+        unlink(socketPath.c_str());
+    }
+
+    listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener == -1)
+        throw exception("Could not create a socket");
+    if (bind(listener, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == -1 || listen(listener, SOMAXCONN) == -1) {
+        close(listener);
+        throw exception("Could not listen on '{}'", socketPath.generic_string());
+    }
+}
+
+Server::~Server() {
+    for (const auto &client : clients)
+        close(client.descriptor);
+    close(listener);
+    unlink(socketPath.c_str());
+}
+
+void Server::run() {
+    // Without SA_RESTART a signal interrupts poll, so the loop notices the stop request
+    struct sigaction action {};
+    action.sa_handler = RequestStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    running = true;
+    while (running && !stopRequested) {
+        std::vector<pollfd> descriptors{{listener, POLLIN, 0}};
+        for (const auto &client : clients)
+            descriptors.push_back({client.descriptor, POLLIN, 0});
+
+        if (poll(descriptors.data(), descriptors.size(), -1) == -1) {
+            if (errno == EINTR)
+                continue;
+            throw exception("Failed to wait for requests");
+        }
+
+        std::vector<bool> connected(clients.size(), true);
+        for (size_t itr{}; itr < clients.size(); itr++)
+            if (descriptors[itr + 1].revents)
+                connected[itr] = receive(clients[itr]);
+        for (size_t itr{clients.size()}; itr-- > 0;)
+            if (!connected[itr]) {
+                close(clients[itr].descriptor);
+                clients.erase(clients.begin() + static_cast<std::ptrdiff_t>(itr));
+            }
+
+        if (descriptors.front().revents & POLLIN)
+            accept();
+    }
+
+    for (const auto &[path, saveFile] : saveFiles)
+        if (saveFile->modified())
+            fmt::print("discarding changes to '{}' that were not flushed\n", path.generic_string());
+}
+
+void Server::accept() {
+    const auto descriptor{::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC)};
+    if (descriptor != -1)
+        clients.push_back({descriptor});
+}
+
+bool Server::receive(Client &client) {
+    std::array<char, 4096> buffer;
+    const auto count{read(client.descriptor, buffer.data(), buffer.size())};
+    if (count <= 0)
+        return count == -1 && errno == EINTR;
+    client.input.append(buffer.data(), static_cast<size_t>(count));
+
+    size_t start{};
+    for (auto end{client.input.find('\n')}; end != std::string::npos; end = client.input.find('\n', start)) {
+        const auto line{std::string_view{client.input}.substr(start, end - start)};
+        start = end + 1;
+        auto response{handle(client, line)};
+        if (response.empty())
+            continue;
+
+        response += '\n';
+        for (size_t sent{}; sent < response.size();) {
+            const auto written{send(client.descriptor, response.data() + sent, response.size() - sent, MSG_NOSIGNAL)};
+            if (written == -1 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+            sent += static_cast<size_t>(written);
+        }
+        if (client.closing || !running)
+            return false;
+    }
+    client.input.erase(0, start);
+    return client.input.size() <= MaximumLineLength;
+}
+
+SaveFile &Server::selected(const Client &client) {
+    const auto saveFile{saveFiles.find(client.save)};
+    if (client.save.empty() || saveFile == saveFiles.end())
+        throw exception("No save file is open, use 'open <savefile>' first");
+    return *saveFile->second;
+}
+
+std::string Server::handle(Client &client, std::string_view line) {
+    try {
+        std::istringstream stream{std::string{line}};
+        const Script request{stream, "request"};
+        if (request.size() == 0)
+            return {};
+
+        const auto &operation{*request.begin()};
+        const auto &arguments{operation.arguments};
+        const auto expectArguments{[&operation](size_t count) {
+            if (operation.arguments.size() != count)
+                throw exception("'{}' expects {} arguments, got {}", operation.command, count, operation.arguments.size());
+        }};
+
+        if (operation.command == "open") {
+            expectArguments(1);
+            const auto path{util::ToAbsolutePath(arguments[0])};
+            // Reload files that were changed by another program, unless that would drop changes that were not flushed yet
+            // The file is only added once it loaded, a failed load leaves no entry behind
+            // It is read into memory instead of mapped, the server would crash touching the mapping once the game truncates the file
+            const auto loaded{saveFiles.find(path)};
+            if (loaded == saveFiles.end() || (!loaded->second->modified() && loaded->second->sourceChanged()))
+                saveFiles.insert_or_assign(path, std::make_unique<SaveFile>(path, false));
+            client.save = path;
+            return "ok";
+        } else if (operation.command == "get-item") {
+            expectArguments(2);
+            auto &saveFile{selected(client)};
+            const auto slot{ToNumber(arguments[0])};
+            if (slot >= saveFile.slots.size())
+                throw exception("Invalid slot index {}", slot);
+            return fmt::format("ok {}", saveFile.getItem(slot, saveFile.items[arguments[1]]));
+        } else if (operation.command == "verify") {
+            expectArguments(0);
+            const auto report{selected(client).verifyChecksums()};
+            if (report.valid())
+                return "ok valid";
+            return fmt::format("ok corrupt{}{}{}", report.headerValid ? "" : " header", report.corruptSlots.empty() ? "" : " ", fmt::join(report.corruptSlots, " "));
+        } else if (operation.command == "flush") {
+            expectArguments(0);
+            auto &saveFile{selected(client)};
+            if (!saveFile.modified())
+                return "ok unchanged";
+            if (saveFile.sourceChanged())
+                throw exception("'{}' was changed by another program since it was opened, use 'discard' to drop the changes", client.save.generic_string());
+            backups.backup(client.save);
+            saveFile.write(client.save);
+            backups.recordWrite(client.save);
+            return "ok written";
+        } else if (operation.command == "discard") {
+            expectArguments(0);
+            selected(client);
+            saveFiles.erase(client.save);
+            return "ok";
+        } else if (operation.command == "quit") {
+            expectArguments(0);
+            client.closing = true;
+            return "ok";
+        } else if (operation.command == "shutdown") {
+            expectArguments(0);
+            running = false;
+            return "ok";
+        }
+
+        request.run(selected(client));
+        return "ok";
+    } catch (const std::exception &e) {
+        return fmt::format("error {}", e.what());
+    }
+}
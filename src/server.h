@@ -0,0 +1,74 @@
+#pragma once
+#include "backupstore.h"
+#include "savefile/savefile.h"
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Keeps save files loaded and applies requests to them that arrive over a Unix socket, see --serve
+ * @note Every request is a single line and gets a single line in response, starting with 'ok' or 'error'. Arguments are parsed like a script.
+ * Changes are kept in memory until they are flushed, so clients can batch edits. Requests are handled one at a time on a single thread.
+ *
+ * open <savefile>                    Load a save file, or reuse it if another client loaded it, and apply all following requests to it
+ * get-item <slot> <item name>        Respond with the quantity of an item
+ * set-item, rename, copy, import and steam-id, see Script
+ * verify                             Respond with 'valid', or 'corrupt' followed by 'header' and the indices of the corrupt slots.
+ *                                    Checksums are only updated by 'flush', so this reports the stored ones
+ * flush                              Write all changes, respond with 'written' or 'unchanged'
+ * discard                            Drop all changes that were not flushed, and unload the save file
+ * quit                               Close the connection
+ * shutdown                           Stop the server, changes that were not flushed are lost
+ */
+class Server {
+  private:
+    struct Client {
+        int descriptor;
+        std::string input{};          //!< Received data that does not form a complete line yet
+        std::filesystem::path save{}; //!< The absolute path of the save file selected with 'open'
+        bool closing{};               //!< Whether the client sent 'quit'
+    };
+
+    constexpr static size_t MaximumLineLength{64 * 1024}; //!< Clients sending longer lines are disconnected
+
+    const std::filesystem::path socketPath;
+    int listener{-1};
+    std::vector<Client> clients;
+    std::map<std::filesystem::path, std::unique_ptr<SaveFile>> saveFiles; //!< All loaded save files by their absolute path, shared between clients
+    const BackupStore backups;                                            //!< Every flush backs up the file it replaces
+    bool running{};
+
+    void accept();
+
+    /**
+     * @brief Handle all complete lines received from a client
+     * @return Whether the client is still connected
+     */
+    bool receive(Client &client);
+
+    /**
+     * @return The response, without the trailing newline
+     */
+    std::string handle(Client &client, std::string_view line);
+
+    SaveFile &selected(const Client &client);
+
+  public:
+    /**
+     * @brief Listen on the given path, replacing a stale socket left behind by an earlier server
+     */
+    Server(std::filesystem::path socketPath);
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    ~Server();
+
+    /**
+     * @brief Serve requests until a client sends 'shutdown' or the process receives SIGINT or SIGTERM
+     */
+    void run();
+};
@@ -0,0 +1,58 @@
+#include "../savefile/inventory.h"
+#include "../savefile/scanner.h"
+#include "test.h"
+
+namespace {
+
+/**
+ * @brief The scan for an empty record the free list replaced, it walks all delimiters on every insertion
+ */
+std::optional<size_t> FindEmptyRecordReference(std::span<const u8> slot) {
+    constexpr static size_t itemSize{10};
+    size_t skipUntil{};
+    for (const size_t delimiter : Scanner::FindDelimiters(slot)) {
+        if (delimiter < skipUntil)
+            continue;
+        const auto nextItem{delimiter + itemSize};
+        if (delimiter + 2 * itemSize > slot.size())
+            break;
+        if (std::all_of(slot.begin() + nextItem, slot.begin() + nextItem + itemSize, [](u8 value) { return value == 0x0; }))
+            return nextItem;
+        skipUntil = delimiter + itemSize + 1;
+    }
+    return std::nullopt;
+}
+
+} // namespace
+
+void Test::Inventory() {
+    std::mt19937 random{1};
+
+    // Small slots dense with delimiters, so records chain into each other and writes keep creating and filling empty records
+    for (size_t round{}; round < 20000; round++) {
+        auto expected{RandomBytes(random, 200 + random() % 400, 60, 20)};
+        auto slot{expected};
+        SlotInventoryIndex index{slot};
+
+        for (size_t step{}; step < 40; step++) {
+            if (random() % 3 == 0) {
+                const auto bytes{RandomBytes(random, 1 + random() % 12, 50, 25)};
+                const auto offset{random() % (slot.size() - 12)};
+                std::copy(bytes.begin(), bytes.end(), expected.begin() + static_cast<std::ptrdiff_t>(offset));
+                index.write(slot, offset, bytes);
+                continue;
+            }
+
+            const auto reference{FindEmptyRecordReference(expected)};
+            const auto taken{index.takeEmptyRecord(slot)};
+            Test::Check(taken == reference, "round {} step {}: took the empty record at {}, the scan finds {}", round, step, taken ? static_cast<long>(*taken) : -1L, reference ? static_cast<long>(*reference) : -1L);
+            if (!taken)
+                break;
+
+            const std::array<u8, 5> item{static_cast<u8>(random()), static_cast<u8>(random()), Items::ItemDelimiter.front(), Items::ItemDelimiter.back(), static_cast<u8>(random() % 3)};
+            std::copy(item.begin(), item.end(), expected.begin() + static_cast<std::ptrdiff_t>(*taken));
+            index.write(slot, *taken, item);
+        }
+        Test::Check(slot == expected, "round {}: writing through the index changed the slot differently than writing directly", round);
+    }
+}
@@ -0,0 +1,38 @@
+#include "../savefile/items.h"
+#include "test.h"
+#include <fmt/core.h>
+#include <functional>
+#include <string_view>
+
+namespace Test {
+
+std::vector<u8> RandomBytes(std::mt19937 &random, size_t size, unsigned zeroPercent, unsigned delimiterPercent) {
+    std::uniform_int_distribution<unsigned> percent{0, 99}, byte{0, 0xFF};
+    std::vector<u8> bytes(size);
+    for (auto &value : bytes) {
+        const auto roll{percent(random)};
+        value = static_cast<u8>(roll < zeroPercent ? 0 : roll < zeroPercent + delimiterPercent ? Items::ItemDelimiter.back() : byte(random));
+    }
+    return bytes;
+}
+
+} // namespace Test
+
+int main(int argc, char **argv) {
+    const std::initializer_list<std::pair<std::string_view, std::function<void()>>> suites{{"scanner", Test::Scanner}, {"md5", Test::Md5}, {"inventory", Test::Inventory}, {"server", Test::Server}};
+    const std::string_view filter{argc > 1 ? argv[1] : ""};
+
+    size_t failed{};
+    for (const auto &[name, suite] : suites) {
+        if (!filter.empty() && name != filter)
+            continue;
+        try {
+            suite();
+            fmt::print("{}: passed\n", name);
+        } catch (const std::exception &e) {
+            failed++;
+            fmt::print("{}: failed: {}\n", name, e.what());
+        }
+    }
+    return failed ? 1 : 0;
+}
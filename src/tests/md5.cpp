@@ -0,0 +1,72 @@
+#include "../md5.h"
+#include "test.h"
+
+namespace {
+
+/**
+ * @brief Hash a batch of inputs through the multi-buffer path and compare every hash against OpenSSL
+ */
+void CompareBatch(std::string_view kernel, const std::vector<std::vector<u8>> &inputs) {
+    std::vector<std::span<const u8>> spans;
+    for (const auto &input : inputs)
+        spans.emplace_back(input);
+
+    const auto hashes{util::GenerateMd5(spans)};
+    std::vector<util::Md5Hash> direct(inputs.size());
+    if (Md5::Lanes())
+        Md5::HashMultiBuffer(spans, direct);
+    for (size_t itr{}; itr < inputs.size(); itr++) {
+        const auto expected{util::GenerateMd5(spans[itr])};
+        Test::Check(hashes[itr] == expected, "{}: input {} of {} bytes in a batch of {} does not match OpenSSL", kernel, itr, inputs[itr].size(), inputs.size());
+        Test::Check(!Md5::Lanes() || direct[itr] == expected, "{}: HashMultiBuffer of input {} of {} bytes in a batch of {} does not match OpenSSL", kernel, itr, inputs[itr].size(), inputs.size());
+    }
+}
+
+} // namespace
+
+void Test::Md5() {
+    for (const auto kernel : Md5::SupportedKernels()) {
+        Md5::UseKernel(kernel);
+        std::mt19937 random{1};
+        const auto lanes{std::max<size_t>(Md5::Lanes(), 1)};
+
+        // The lengths around the padding: 55 bytes still fit the length into the last block, 56 do not
+        for (const size_t size : {0, 1, 55, 56, 63, 64, 65, 119, 120, 128}) {
+            std::vector<std::vector<u8>> inputs;
+            for (size_t itr{}; itr < lanes + 1; itr++)
+                inputs.push_back(RandomBytes(random, size));
+            CompareBatch(kernel, inputs);
+        }
+
+        // More inputs than lanes and of mixed sizes, so lanes are refilled while others are still running
+        for (size_t round{}; round < 16; round++) {
+            std::vector<std::vector<u8>> inputs;
+            const auto count{2 + random() % (lanes * 3)};
+            for (size_t itr{}; itr < count; itr++)
+                inputs.push_back(RandomBytes(random, random() % 4 ? random() % 300 : random() % 0x10000));
+            CompareBatch(kernel, inputs);
+        }
+
+        // Streams whose pieces arrive one at a time, some of them empty
+        for (size_t round{}; round < 8; round++) {
+            const auto count{1 + random() % (lanes * 2 + 1)};
+            Md5::Streams streams{count};
+            std::vector<std::vector<u8>> contents(count);
+            for (size_t piece{}; piece < 6; piece++) {
+                std::vector<std::vector<u8>> pieces;
+                for (size_t itr{}; itr < count; itr++)
+                    pieces.push_back(RandomBytes(random, random() % 3 ? 64 * (random() % 5) : 0));
+                std::vector<std::span<const u8>> spans;
+                for (size_t itr{}; itr < count; itr++) {
+                    spans.emplace_back(pieces[itr]);
+                    contents[itr].insert(contents[itr].end(), pieces[itr].begin(), pieces[itr].end());
+                }
+                streams.update(spans);
+            }
+
+            const auto hashes{streams.finish()};
+            for (size_t itr{}; itr < count; itr++)
+                Check(hashes[itr] == util::GenerateMd5(contents[itr]), "{}: stream {} of {} bytes does not match OpenSSL", kernel, itr, contents[itr].size());
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#include "../savefile/items.h"
+#include "../savefile/scanner.h"
+#include "test.h"
+
+namespace {
+
+/**
+ * @brief The scalar loop FindDelimiters replaced
+ */
+std::vector<u32> FindDelimitersReference(std::span<const u8> data) {
+    std::vector<u32> result;
+    for (size_t offset{}; offset + 1 < data.size(); offset++)
+        if (data[offset] == Items::ItemDelimiter.front() && data[offset + 1] == Items::ItemDelimiter.back())
+            result.push_back(static_cast<u32>(offset));
+    return result;
+}
+
+void Compare(std::string_view kernel, std::span<const u8> data, std::string_view description) {
+    const auto expected{FindDelimitersReference(data)};
+    const auto found{Scanner::FindDelimiters(data)};
+    Test::Check(found == expected, "{}: {} of {} bytes: found {} delimiters, expected {}", kernel, description, data.size(), found.size(), expected.size());
+}
+
+} // namespace
+
+void Test::Scanner() {
+    for (const auto kernel : Scanner::SupportedKernels()) {
+        Scanner::UseKernel(kernel);
+        std::mt19937 random{1};
+
+        // Every length up to a few vector widths, so each tail length is covered
+        for (size_t size{}; size <= 64; size++)
+            for (size_t round{}; round < 32; round++)
+                Compare(kernel, RandomBytes(random, size, 40, 30), "random");
+
+        // A delimiter split between two vectors, or between the last vector and the tail
+        for (const size_t width : {16, 32, 64})
+            for (size_t boundary{width}; boundary <= width * 4; boundary += width)
+                for (size_t size{boundary + 1}; size <= boundary + 3; size++) {
+                    std::vector<u8> data(size, 0xFF);
+                    data[boundary - 1] = Items::ItemDelimiter.front();
+                    data[boundary] = Items::ItemDelimiter.back();
+                    Compare(kernel, data, fmt::format("a delimiter at 0x{:X}", boundary - 1));
+                }
+
+        // All zeros and all delimiters
+        Compare(kernel, std::vector<u8>(257, 0), "zero");
+        std::vector<u8> delimiters(258);
+        for (size_t itr{}; itr < delimiters.size(); itr++)
+            delimiters[itr] = itr % 2 ? Items::ItemDelimiter.back() : Items::ItemDelimiter.front();
+        Compare(kernel, delimiters, "delimiters");
+
+        // The size of a slot
+        Compare(kernel, RandomBytes(random, 0x280000, 50, 10), "random");
+    }
+}
@@ -0,0 +1,115 @@
+#include "../server.h"
+#include "../savefile/generator.h"
+#include "test.h"
+#include <cstdlib>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief A connection to the server, sending one request at a time
+ */
+class Connection {
+  private:
+    int descriptor{-1};
+
+  public:
+    Connection(const std::filesystem::path &socketPath) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        const auto &name{socketPath.native()};
+        std::copy(name.begin(), name.end(), address.sun_path);
+        descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        Test::Check(descriptor != -1 && connect(descriptor, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0, "Could not connect to '{}'", name);
+    }
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    ~Connection() {
+        if (descriptor != -1)
+            close(descriptor);
+    }
+
+    std::string request(std::string_view line) {
+        const auto message{fmt::format("{}\n", line)};
+        Test::Check(::write(descriptor, message.data(), message.size()) == static_cast<ssize_t>(message.size()), "Could not send '{}'", line);
+
+        std::string response;
+        for (char character{}; character != '\n';) {
+            Test::Check(::read(descriptor, &character, 1) == 1, "The server closed the connection after '{}'", line);
+            response += character;
+        }
+        response.pop_back();
+        return response;
+    }
+};
+
+} // namespace
+
+void Test::Server() {
+    std::string directoryTemplate{(std::filesystem::temp_directory_path() / "erutils-test-XXXXXX").string()};
+    Test::Check(mkdtemp(directoryTemplate.data()) != nullptr, "Could not create a temporary directory");
+    const std::filesystem::path directory{directoryTemplate};
+    setenv("XDG_DATA_HOME", directory.c_str(), 1); // Keeps the backups of flushes out of the users data directory
+
+    const auto savePath{directory / "ER0000.sl2"};
+    SaveGenerator::Write(savePath, {});
+
+    // An item the first slot holds, to ask the server for
+    std::string itemName;
+    u32 quantity{};
+    {
+        SaveFile saveFile{savePath};
+        for (const auto &item : GeneratedItems::items)
+            if ((quantity = saveFile.getItem(0, saveFile.items[item.name]))) {
+                itemName = item.name;
+                break;
+            }
+    }
+    Test::Check(quantity != 0, "The generated save file holds no items in slot 0");
+    const auto getItem{fmt::format("get-item 0 \"{}\"", itemName)};
+
+    ::Server server{directory / "socket"};
+    std::thread runner{[&server]() {
+        server.run();
+    }};
+
+    std::string failure;
+    try {
+        Connection connection{directory / "socket"};
+        Test::Check(connection.request(fmt::format("open \"{}\"", savePath.string())) == "ok", "Could not open the save file");
+        Test::Check(connection.request(getItem) == fmt::format("ok {}", quantity), "The server reports a different quantity than the file holds");
+
+        // Another program rewrites the file in place, the loaded save data must not change underneath the server
+        {
+            SaveFile saveFile{savePath};
+            saveFile.setItem(0, saveFile.items[itemName], quantity + 1);
+            saveFile.write(savePath);
+        }
+        Test::Check(connection.request(getItem) == fmt::format("ok {}", quantity), "A rewrite of the file leaked into the loaded save data");
+
+        // Touching a mapping of a truncated file would kill the whole process
+        std::filesystem::resize_file(savePath, 0);
+        Test::Check(connection.request(getItem) == fmt::format("ok {}", quantity), "The loaded save data changed after the file was truncated");
+        Test::Check(connection.request("verify") == "ok valid", "The loaded save data is no longer valid after the file was truncated");
+
+        Test::Check(connection.request(fmt::format("set-item 0 \"{}\" 1", itemName)) == "ok", "Could not set the quantity of an item");
+        Test::Check(connection.request("flush").starts_with("error"), "Flushing over a file another program changed did not fail");
+        connection.request("shutdown");
+    } catch (const std::exception &e) {
+        failure = e.what();
+        // Stops the server if the test failed before sending 'shutdown'
+        try {
+            Connection{directory / "socket"}.request("shutdown");
+        } catch (const std::exception &) {
+        }
+    }
+    runner.join();
+    std::filesystem::remove_all(directory);
+    if (!failure.empty())
+        throw exception("{}", failure);
+}
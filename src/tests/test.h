@@ -0,0 +1,35 @@
+#pragma once
+#include "../util.h"
+#include <random>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Checks that compare the optimized paths against straightforward reference implementations, see ctest
+ */
+namespace Test {
+
+/**
+ * @brief Fail the running test if the condition does not hold
+ */
+template <typename S, typename... Args> void Check(bool condition, const S &format, Args &&...args) {
+    if (!condition)
+        throw exception(format, std::forward<Args>(args)...);
+}
+
+/**
+ * @brief Random bytes with a fixed seed, so a failure can be reproduced
+ * @param zeroPercent How many of the bytes are zero
+ * @param delimiterPercent How many of the bytes are the second delimiter byte, so delimiters occur far more often than in random data
+ */
+std::vector<u8> RandomBytes(std::mt19937 &random, size_t size, unsigned zeroPercent = 0, unsigned delimiterPercent = 0);
+
+void Scanner();
+
+void Md5();
+
+void Inventory();
+
+void Server();
+
+} // namespace Test
@@ -0,0 +1,44 @@
+#include "../arguments.h"
+#include "../savefile/generator.h"
+#include "../savefile/savefile.h"
+
+int main(int argc, char **argv) {
+    CommandLineArguments::ArgumentParser arguments(argc, argv);
+    SaveGenerator::Options options;
+
+    auto output{arguments.add<std::string_view>({"--output", "<savefile>", "The path to write the generated savefile to"})};
+    auto slots{arguments.add<size_t>({"--slots", "<slot count>", "The amount of active slots, by default 3"})};
+    auto items{arguments.add<size_t>({"--items", "<item count>", "The amount of inventory records in each active slot, by default 400"})};
+    auto noise{arguments.add<size_t>({"--noise", "<percentage>", "The share of random bytes in the remaining slot data, by default 25"})};
+    auto steamId{arguments.add<u64>({"--steam-id", "<Steam ID>", "The Steam ID to embed in the savefile"})};
+    auto seed{arguments.add<u32>({"--seed", "<seed>", "Seed for the random data, the same seed and options always generate the same savefile"})};
+    auto help{arguments.add<bool>({"--help", "Print this help message"})};
+    arguments.check();
+
+    if (help.set || !output.set) {
+        arguments.showUsage();
+        return help.set ? 0 : 1;
+    }
+
+    if (slots.set)
+        options.activeSlots = slots.value;
+    if (items.set)
+        options.itemsPerSlot = items.value;
+    if (noise.set) {
+        if (noise.value > 100)
+            throw exception("Invalid noise percentage {}", noise.value);
+        options.noisePercent = static_cast<u8>(noise.value);
+    }
+    if (steamId.set)
+        options.steamId = steamId.value;
+    if (seed.set)
+        options.seed = seed.value;
+
+    SaveGenerator::Write(output.value, options);
+
+    // Load the result like any other savefile, so a layout mismatch is caught here rather than in a benchmark
+    const SaveFile saveFile{output.value};
+    if (!saveFile.verifyChecksums().valid())
+        throw exception("The generated savefile '{}' has invalid checksums", output.value);
+    fmt::print("generated '{}' with {} active slots of {} items each, Steam ID {}\n", output.value, options.activeSlots, options.itemsPerSlot, saveFile.steamId());
+}
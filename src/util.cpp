@@ -1,35 +1,201 @@
 #include "util.h"
+#include "md5.h"
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <fcntl.h>
+#include <fstream>
 #include <functional>
+#include <glob.h>
+#include <mutex>
+#include <semaphore>
 #include <openssl/evp.h>
 #include <span>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 namespace util {
 
-const Md5Hash GenerateMd5(std::span<u8> input) {
-    Md5Hash hash{};
-    auto context{EVP_MD_CTX_new()};
-    EVP_DigestInit_ex(context, EVP_md5(), nullptr);
+const Md5Hash GenerateMd5(std::span<const u8> input) {
+    Md5Context context;
+    context.update(input);
+    return context.finish();
+}
+
+Md5Context::Md5Context() : context{EVP_MD_CTX_new()} {
+    if (!context || !EVP_DigestInit_ex(context, EVP_md5(), nullptr))
+        throw exception("Failed to create an MD5 context");
+}
+
+Md5Context::~Md5Context() {
+    EVP_MD_CTX_free(context);
+}
+
+void Md5Context::update(std::span<const u8> input) {
+    Profiler::ScopedTimer timer{Profiler::Phase::Md5, input.size_bytes()};
     EVP_DigestUpdate(context, input.data(), input.size_bytes());
+}
+
+Md5Hash Md5Context::finish() {
+    Md5Hash hash{};
     EVP_DigestFinal_ex(context, hash.data(), nullptr);
     return hash;
 }
 
+const Sha256Hash GenerateSha256(std::span<const u8> input) {
+    Sha256Hash hash{};
+    if (!EVP_Digest(input.data(), input.size_bytes(), hash.data(), nullptr, EVP_sha256(), nullptr))
+        throw exception("Failed to calculate a SHA-256 hash");
+    return hash;
+}
+
+std::vector<Md5Hash> GenerateMd5(const std::vector<std::span<const u8>> &inputs) {
+    std::vector<Md5Hash> hashes(inputs.size());
+    // A single stream is faster through OpenSSL, which is also the fallback on CPUs without a multi-buffer kernel
+    if (inputs.size() < 2 || !Md5::Lanes()) {
+        for (size_t itr{}; itr < inputs.size(); itr++)
+            hashes[itr] = GenerateMd5(inputs[itr]);
+        return hashes;
+    }
+
+    size_t bytes{};
+    for (const auto &input : inputs)
+        bytes += input.size_bytes();
+    Profiler::ScopedTimer timer{Profiler::Phase::Md5, bytes};
+    Md5::HashMultiBuffer(inputs, hashes);
+    return hashes;
+}
+
+void StreamFile(const std::filesystem::path &path, const std::vector<std::vector<Section>> &groups, size_t bufferCount, const std::function<void(size_t, std::span<const u8>)> &consume) {
+    const auto descriptor{open(path.c_str(), O_RDONLY)};
+    if (descriptor == -1)
+        throw exception("Could not open file '{}'", ToAbsolutePath(path).generic_string());
+
+    size_t bufferSize{};
+    for (const auto &group : groups) {
+        size_t size{};
+        for (const auto &section : group)
+            size += section.size;
+        bufferSize = std::max(bufferSize, size);
+    }
+
+    // Buffers are used as a ring, the semaphores count the buffers each side can use
+    std::vector<std::vector<u8>> buffers(std::clamp<size_t>(bufferCount, 1, std::max<size_t>(groups.size(), 1)), std::vector<u8>(bufferSize));
+    std::counting_semaphore<> emptyBuffers{static_cast<std::ptrdiff_t>(buffers.size())};
+    std::counting_semaphore<> filledBuffers{0};
+    std::atomic<bool> stopped{};
+    std::string error;
+
+    std::thread reader{[&]() {
+        for (size_t group{}; group < groups.size(); group++) {
+            emptyBuffers.acquire();
+            if (stopped)
+                return;
+
+            Profiler::ScopedTimer timer{Profiler::Phase::Load};
+            auto *buffer{buffers[group % buffers.size()].data()};
+            for (const auto &section : groups[group]) {
+                size_t size{};
+                while (size < section.size && error.empty()) {
+                    const auto count{pread(descriptor, buffer + size, section.size - size, static_cast<off_t>(section.address + size))};
+                    if (count == -1 && errno == EINTR)
+                        continue;
+                    if (count <= 0)
+                        error = fmt::format("Could not read {} bytes at 0x{:X} from '{}'", section.size, section.address, ToAbsolutePath(path).generic_string());
+                    else
+                        size += static_cast<size_t>(count);
+                }
+                buffer += section.size;
+            }
+            timer.addBytes(static_cast<size_t>(buffer - buffers[group % buffers.size()].data()));
+
+            filledBuffers.release();
+            if (!error.empty())
+                return;
+        }
+    }};
+
+    const auto finish{[&]() {
+        stopped = true;
+        emptyBuffers.release();
+        reader.join();
+        close(descriptor);
+    }};
+
+    try {
+        for (size_t group{}; group < groups.size(); group++) {
+            filledBuffers.acquire();
+            if (!error.empty())
+                throw exception("{}", error);
+
+            size_t size{};
+            for (const auto &section : groups[group])
+                size += section.size;
+            consume(group, std::span{buffers[group % buffers.size()]}.first(size));
+            emptyBuffers.release();
+        }
+    } catch (...) {
+        finish();
+        throw;
+    }
+    finish();
+}
+
+size_t DefaultThreadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ParallelFor(size_t count, size_t threads, const std::function<void(size_t)> &function) {
+    threads = std::clamp<size_t>(threads, 1, count);
+    if (threads <= 1) {
+        for (size_t i{}; i < count; i++)
+            function(i);
+        return;
+    }
+
+    std::atomic<size_t> next{};
+    std::exception_ptr error{};
+    std::mutex errorMutex;
+    const auto worker{[&]() {
+        for (auto i{next++}; i < count; i = next++) {
+            try {
+                function(i);
+            } catch (...) {
+                const std::lock_guard lock{errorMutex};
+                if (!error)
+                    error = std::current_exception();
+            }
+        }
+    }};
+
+    std::vector<std::thread> pool;
+    for (size_t i{1}; i < threads; i++)
+        pool.emplace_back(worker);
+    worker();
+    for (auto &thread : pool)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
 class Utf8Utf16Converter : public std::codecvt<char16_t, char8_t, std::mbstate_t> {
   public:
     ~Utf8Utf16Converter() override = default;
 };
 
 const std::string Utf16ToUtf8String(std::span<u8> chars) {
+    constexpr static size_t MaxUtf8Size{3}; //!< The maximum amount of UTF-8 bytes a single UTF-16 code unit can be converted to
     std::u16string_view text{reinterpret_cast<const char16_t *>(chars.data()), chars.size_bytes() / sizeof(char16_t)};
-    std::span<char8_t> u8chars(reinterpret_cast<char8_t *>(chars.data()), chars.size_bytes() / sizeof(char8_t));
-    Utf8Utf16Converter::state_type convert_state;
+    text = text.substr(0, text.find(u'\0'));
+    // Convert into a separate buffer, writing into the input would modify the save data without updating its checksum
+    std::u8string u8chars(text.size() * MaxUtf8Size, u8'\0');
+    Utf8Utf16Converter::state_type convert_state{};
     const char16_t *from_next;
     char8_t *to_next;
-    Utf8Utf16Converter().out(convert_state, text.data(), text.end(), from_next, u8chars.data(), u8chars.end().base(), to_next);
-    // Null terminate the string, if it isn't out of bounds
-    if (to_next < reinterpret_cast<const char8_t *>(text.end()))
-        *to_next = u8'\0';
+    Utf8Utf16Converter().out(convert_state, text.data(), text.data() + text.size(), from_next, u8chars.data(), u8chars.data() + u8chars.size(), to_next);
 
     return std::string().assign(u8chars.data(), to_next);
 }
@@ -77,6 +243,32 @@ Maybe<std::filesystem::path> FindFileInSubDirectory(std::filesystem::path direct
     return fmt::format("Could not find file '{}' in any subdirectory of '{}'", filename, directory.string());
 }
 
+std::vector<std::filesystem::path> FindFiles(std::string_view pattern, std::string_view filename) {
+    std::vector<std::filesystem::path> roots;
+    if (std::filesystem::is_directory(pattern))
+        roots.emplace_back(pattern);
+    else {
+        glob_t matches{};
+        if (glob(std::string{pattern}.c_str(), 0, nullptr, &matches) == 0)
+            roots.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+        globfree(&matches);
+    }
+
+    std::vector<std::filesystem::path> result;
+    for (const auto &root : roots) {
+        if (std::filesystem::is_directory(root)) {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(root, std::filesystem::directory_options::skip_permission_denied))
+                if (entry.is_regular_file() && entry.path().filename() == filename)
+                    result.push_back(entry.path());
+        } else if (std::filesystem::is_regular_file(root))
+            result.push_back(root);
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
 u64 GetSteamId(std::filesystem::path saveFilePath) {
     u64 steamId;
     try {
@@ -103,31 +295,4 @@ std::filesystem::path CreateDataDirectory() {
     return directory;
 }
 
-std::filesystem::path CreateBackupDirectory() {
-    auto directory{CreateDataDirectory() / "backup"};
-    const auto timePoint{std::chrono::system_clock::to_time_t(std::chrono::system_clock::now())};
-    auto timeStamp{fmt::format("{}", std::ctime(&timePoint))}; // TODO: format this in a better way
-    timeStamp.pop_back();                                      // remove newline, thanks ctime
-    if (!std::filesystem::exists(directory))
-        std::filesystem::create_directory(directory);
-
-    directory /= timeStamp;
-    if (!std::filesystem::exists(directory))
-        std::filesystem::create_directory(directory);
-    return directory;
-}
-
-std::filesystem::path BackupSavefile(std::filesystem::path saveFilePath) {
-    auto backupDir{util::CreateBackupDirectory()};
-    std::filesystem::path bakFilePath{saveFilePath.string() + ".bak"};
-    if (std::filesystem::exists(saveFilePath))
-        std::filesystem::copy(saveFilePath, backupDir / saveFilePath.filename());
-    if (std::filesystem::exists(bakFilePath)) {
-        std::filesystem::copy(bakFilePath, backupDir / bakFilePath.filename());
-        std::filesystem::remove(bakFilePath); // If this differentiates from ER0000.sl2 the game will claim the savefile is corrupt
-    }
-
-    return backupDir;
-}
-
 } // namespace util
@@ -1,97 +1,19 @@
+#include "common.h"
+#include "filebuffer.h"
+#include "profiler.h"
 #include <filesystem>
 #include <fmt/format.h>
 #include <functional>
+#include <openssl/evp.h>
 #include <openssl/md5.h>
+#include <openssl/sha.h>
 #include <span>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #pragma once
 
-using u64 = __uint64_t; //!< Unsigned 64-bit integer
-using u32 = __uint32_t; //!< Unsigned 32-bit integer
-using u16 = __uint16_t; //!< Unsigned 16-bit integer
-using u8 = __uint8_t;   //!< Unsigned 8-bit integer
-
-/**
- * @brief A wrapper around std::runtime_error with {fmt} formatting
- */
-class exception : public std::runtime_error {
-  public:
-    template <typename S, typename... Args> constexpr auto Format(S formatString, Args &&...args) {
-        return fmt::format(fmt::runtime(formatString), FmtCast(args)...);
-    }
-
-    template <typename T> constexpr auto FmtCast(T object) {
-        if constexpr (std::is_pointer<T>::value)
-            if constexpr (std::is_same<char, typename std::remove_cv<typename std::remove_pointer<T>::type>::type>::value)
-                return reinterpret_cast<typename std::common_type<char *, T>::type>(object);
-            else
-                return reinterpret_cast<const uintptr_t>(object);
-        else
-            return object;
-    }
-
-    template <typename S, typename... Args> exception(const S &formatStr, Args &&...args) : runtime_error(Format(formatStr, args...)) {}
-};
-
-/**
- * @brief An object representing a range of bytes in a file with some utility functions
- */
-struct Section {
-    size_t address;
-    size_t length;
-    size_t size;
-
-    constexpr Section(size_t address, size_t size) : address{address}, length{address + size}, size{size} {}
-
-    /**
-     * @brief Get the range of bytes from the given data as an integer
-     */
-    template <typename T> constexpr T castInteger(const std::span<u8> data) const {
-        // clang-format off
-        using Type = std::conditional_t<sizeof(T) % sizeof(u64) == 0, u64,
-                     std::conditional_t<sizeof(T) % sizeof(u32) == 0, u32,
-                     std::conditional_t<sizeof(T) % sizeof(u16) == 0, u16, u8>>>;
-        // clang-format on
-
-        return static_cast<T>(*reinterpret_cast<const Type *>(data.data() + address));
-    }
-
-    /**
-     * @brief Replace a section inside of the save file
-     * @param data The data to modify
-     * @param newSection The data to replace the section with
-     */
-    constexpr void replace(std::span<u8> data, const std::span<u8> newSection) const {
-        if (address > data.size_bytes() || size > data.size_bytes())
-            throw exception("Invalid offset range while replacing: [0x{:X}, 0x{:X}], size: 0x{:X}", address, length, data.size_bytes());
-        if (newSection.size_bytes() != size)
-            throw exception("New section size 0x{:X} does not match old section size 0x{:X}", newSection.size_bytes(), size);
-
-        std::copy(newSection.begin(), newSection.end(), data.begin() + address);
-    }
-
-    template <class C> constexpr void replace(std::span<u8> data, C newString) const {
-        if (newString.size() < size)
-            std::fill(data.begin() + address + newString.size(), data.begin() + address + size, 0); // 0 fill the remainder of the section
-        else if (newString.size() > size)
-            throw exception("String with length {:X} is bigger than section size {:X}", newString.size(), size);
-
-        std::copy(newString.data(), newString.data() + newString.size(), data.begin() + address);
-    }
-
-    constexpr std::span<u8> bytesFrom(const std::span<u8> data) const {
-        if (address > data.size_bytes() || size > data.size_bytes())
-            throw exception("Invalid offset range: [{}, {}], size: {}", address, length, data.size_bytes());
-
-        return data.subspan(address, length - address);
-    }
-
-    std::string_view stringFrom(const std::span<u8> data) const {
-        return {reinterpret_cast<const char *>(bytesFrom(data).data()), size};
-    }
-};
-
 /**
  * @brief An object that may or may not contain a value
  */
@@ -119,25 +41,86 @@ template <class C> constexpr u32 getDigits(C input) {
 
 /**
  * @brief Replace all occurances of a span inside of another span
+ * @return The offsets of all replaced occurances
  */
-template <typename T, class C> constexpr void ReplaceAll(std::span<T> data, std::span<T> find, C replace) {
+template <typename T, class C> std::vector<size_t> ReplaceAll(std::span<T> data, std::span<T> find, C replace) {
+    Profiler::ScopedTimer timer{Profiler::Phase::ReplaceAll, data.size_bytes()};
+    std::vector<size_t> offsets{};
     size_t index{};
     if (find.size_bytes() != replace.size())
         throw exception("Size of find does not match replace");
 
     while (true) {
         auto itr{std::search(data.begin() + index, data.end(), find.begin(), find.end())};
+        Profiler::CountSearch((itr - (data.begin() + index)) * sizeof(T));
         if (itr == data.end())
             break;
 
         std::copy(replace.begin(), replace.end(), itr);
         index = itr - data.begin() + 1;
+        offsets.push_back(index - 1);
     }
+
+    return offsets;
 }
 
 using Md5Hash = std::array<u8, MD5_DIGEST_LENGTH>;
 
-const Md5Hash GenerateMd5(std::span<u8> input);
+const Md5Hash GenerateMd5(std::span<const u8> input);
+
+/**
+ * @brief Hashes data that arrives in pieces, the result matches hashing all pieces at once
+ */
+class Md5Context {
+  private:
+    EVP_MD_CTX *context;
+
+  public:
+    Md5Context();
+
+    Md5Context(Md5Context &&other) noexcept : context{std::exchange(other.context, nullptr)} {}
+    Md5Context(const Md5Context &) = delete;
+    Md5Context &operator=(const Md5Context &) = delete;
+
+    ~Md5Context();
+
+    void update(std::span<const u8> input);
+
+    /**
+     * @brief Get the hash of all data passed to update, after which the context can not be used anymore
+     */
+    Md5Hash finish();
+};
+
+using Sha256Hash = std::array<u8, SHA256_DIGEST_LENGTH>;
+
+const Sha256Hash GenerateSha256(std::span<const u8> input);
+
+/**
+ * @brief Hash several independent inputs, interleaved in the lanes of vector registers when the CPU supports it
+ * @return The hash of every input, in the same order
+ */
+std::vector<Md5Hash> GenerateMd5(const std::vector<std::span<const u8>> &inputs);
+
+/**
+ * @brief Read groups of ranges from a file on a separate thread, so reading the next groups overlaps with consuming the current one
+ * @param groups The ranges of each group are read back to back into a single buffer
+ * @param bufferCount The amount of groups that can be in flight, memory use is bounded by this times the largest group
+ * @param consume Called on the calling thread for every group in order, with the index of the group and its data
+ */
+void StreamFile(const std::filesystem::path &path, const std::vector<std::vector<Section>> &groups, size_t bufferCount, const std::function<void(size_t, std::span<const u8>)> &consume);
+
+/**
+ * @brief The number of threads to use by default, based on the amount of CPU cores
+ */
+size_t DefaultThreadCount();
+
+/**
+ * @brief Call a function for every index in [0, count) on a pool of threads
+ * @param threads The maximum amount of threads to use, with 1 the function is called in order on the current thread
+ * @note If any of the calls throws, the first exception is rethrown after all threads have finished
+ */
+void ParallelFor(size_t count, size_t threads, const std::function<void(size_t)> &function);
 
 void Utf8ToUtf16(std::span<u8> chars, std::u16string_view text);
 
@@ -160,6 +143,13 @@ u64 GetSteamId(std::filesystem::path saveFilePath);
 
 Maybe<std::filesystem::path> FindFileInSubDirectory(std::filesystem::path directory, std::string_view filename);
 
+/**
+ * @brief Find all files with the given name below a directory, or matching a glob pattern
+ * @param pattern A directory to search recursively, or a glob pattern. Directories matching the pattern are searched recursively as well.
+ * @return All matching files, sorted by path
+ */
+std::vector<std::filesystem::path> FindFiles(std::string_view pattern, std::string_view filename);
+
 /**
  * @brief Get an std::filesystem::path's absolute path, used for logging
  */
@@ -170,14 +160,4 @@ const std::filesystem::path ToAbsolutePath(std::filesystem::path path);
  */
 std::filesystem::path CreateDataDirectory();
 
-/**
- * @brief The directory to write a backup of the save file to at runtime
- */
-std::filesystem::path CreateBackupDirectory();
-
-/**
- * @brief Copy the savefile to the backup directory
- */
-std::filesystem::path BackupSavefile(std::filesystem::path saveFilePath);
-
 } // namespace util
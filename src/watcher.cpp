@@ -0,0 +1,160 @@
+#include "watcher.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief Read groups of sections of a file into the mirror of it, at their offsets in the file
+ */
+void ReadSections(const std::filesystem::path &path, const std::vector<std::vector<Section>> &groups, SaveSpan data) {
+    util::StreamFile(path, groups, 2, [&groups, data](size_t group, std::span<const u8> buffer) {
+        for (const auto &section : groups[group]) {
+            std::copy_n(buffer.begin(), section.size, section.bytesFrom(data).begin());
+            buffer = buffer.subspan(section.size);
+        }
+    });
+}
+
+} // namespace
+
+Watcher::Watcher(std::filesystem::path path) : path{std::move(path)}, mirror(SaveFileSize) {
+    for (size_t itr{}; itr < SaveFile::SlotCount; itr++)
+        slots.emplace_back(itr);
+}
+
+void Watcher::refresh() {
+    const auto target{util::ToAbsolutePath(path).generic_string()};
+    if (std::filesystem::file_size(path) != SaveFileSize)
+        throw exception("{} is not a valid Elden Ring save file.", target);
+
+    // The metadata of all slots is only a few kilobytes, so it is read on every write
+    auto saveData{data()};
+    std::vector<Section> metadata{SaveFile::HeaderBNDSection, Slot::ActiveSection};
+    for (const auto &slot : slots) {
+        metadata.push_back(slot.SlotChecksumSection);
+        metadata.push_back(slot.SlotHeaderSection);
+    }
+    ReadSections(path, {metadata}, saveData);
+    if (SaveFile::HeaderBNDSection.stringFrom(saveData) != "BND")
+        throw exception("{} is not a valid Elden Ring save file.", target);
+    for (const auto &slot : slots)
+        for (const auto &section : metadata)
+            slot.invalidateMetadata(section);
+
+    // The checksum of a slot covers all of its data, so only slots with a different checksum have to be read
+    std::vector<size_t> changed;
+    std::vector<std::vector<Section>> groups;
+    for (const auto &slot : slots) {
+        const auto &state{states[slot.index]};
+        if (slot.active(saveData) && (!state || state->quantities.empty() || !slot.checksumMatches(saveData, state->checksum))) {
+            changed.push_back(slot.index);
+            groups.push_back({slot.SlotSection});
+        }
+    }
+    ReadSections(path, groups, saveData);
+
+    // A slot that does not match its checksum was read while the game was still writing it, the next write reports it instead
+    std::vector<std::span<const u8>> changedData;
+    for (const auto index : changed)
+        changedData.push_back(slots[index].checksummedData(saveData));
+    const auto hashes{util::GenerateMd5(changedData)};
+    std::vector<size_t> torn;
+    for (size_t itr{}; itr < changed.size(); itr++) {
+        slots[changed[itr]].invalidateInventory();
+        if (!slots[changed[itr]].checksumMatches(saveData, hashes[itr]))
+            torn.push_back(changed[itr]);
+    }
+
+    for (const auto &slot : slots) {
+        if (std::ranges::find(torn, slot.index) != torn.end()) {
+            fmt::print("warning: slot {} was read while it was being written, waiting for the next write\n", slot.index);
+            continue;
+        }
+
+        auto &previous{states[slot.index]};
+        SlotState current{.active = slot.active(saveData)};
+        if (current.active) {
+            current.name = slot.name(saveData);
+            current.level = slot.level(saveData);
+            std::copy_n(slot.SlotChecksumSection.bytesFrom(saveData).begin(), current.checksum.size(), current.checksum.begin());
+            if (std::ranges::find(changed, slot.index) != changed.end())
+                for (const auto &item : items)
+                    current.quantities.push_back(slot.getItemQuantity(saveData, item));
+            else
+                current.quantities = previous->quantities;
+        }
+
+        report(slot.index, previous, current);
+        previous = std::move(current);
+    }
+    std::fflush(stdout);
+}
+
+void Watcher::report(size_t slotIndex, const std::optional<SlotState> &previous, const SlotState &current) const {
+    const auto wasActive{previous && previous->active};
+    if (!current.active) {
+        if (wasActive)
+            fmt::print("slot {}: inactive\n", slotIndex);
+        return;
+    }
+    if (!wasActive) {
+        fmt::print("slot {}: active, {}, level {}\n", slotIndex, current.name, current.level);
+        return;
+    }
+
+    if (previous->name != current.name)
+        fmt::print("slot {}: renamed from {} to {}\n", slotIndex, previous->name, current.name);
+    if (previous->level != current.level)
+        fmt::print("slot {}: level {} -> {}\n", slotIndex, previous->level, current.level);
+    size_t itr{};
+    for (const auto &item : items) {
+        if (previous->quantities[itr] != current.quantities[itr])
+            fmt::print("slot {}: {} {} -> {}\n", slotIndex, item.name, previous->quantities[itr], current.quantities[itr]);
+        itr++;
+    }
+}
+
+void Watcher::run() {
+    const auto directory{path.has_parent_path() ? path.parent_path() : std::filesystem::path{"."}};
+    const auto descriptor{inotify_init1(IN_CLOEXEC)};
+    if (descriptor == -1)
+        throw exception("Could not initialize inotify");
+    // The game may write the file in place or replace it, which only shows up on the directory
+    if (inotify_add_watch(descriptor, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+        close(descriptor);
+        throw exception("Could not watch directory '{}'", util::ToAbsolutePath(directory).generic_string());
+    }
+
+    refresh();
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer;
+    while (true) {
+        const auto count{read(descriptor, buffer.data(), buffer.size())};
+        if (count == -1 && errno == EINTR)
+            continue;
+        if (count <= 0) {
+            close(descriptor);
+            throw exception("Failed to wait for changes to '{}'", util::ToAbsolutePath(path).generic_string());
+        }
+
+        // Several writes in a row are handled by a single refresh
+        bool written{};
+        for (ssize_t offset{}; offset < count;) {
+            const auto *event{reinterpret_cast<const inotify_event *>(buffer.data() + offset)};
+            written |= event->len && path.filename() == event->name;
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+        if (!written)
+            continue;
+
+        try {
+            refresh();
+        } catch (const std::exception &e) {
+            fmt::print("warning: {}\n", e.what());
+            std::fflush(stdout);
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "savefile/savefile.h"
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Follows a save file while the game writes it and prints an event for every change to its slots, see --watch
+ * @note Every write only reads the checksums, active flags and slot headers. The data of a slot is only read and its inventory compared when its stored checksum changed
+ *
+ * slot <index>: active, <name>, level <level>
+ * slot <index>: inactive
+ * slot <index>: renamed from <old name> to <new name>
+ * slot <index>: level <old level> -> <new level>
+ * slot <index>: <item name> <old quantity> -> <new quantity>
+ */
+class Watcher {
+  private:
+    /**
+     * @brief What was last reported about a slot
+     */
+    struct SlotState {
+        util::Md5Hash checksum{}; //!< The stored checksum of the data the quantities were read from
+        bool active{};
+        std::string name{};
+        u64 level{};
+        std::vector<u32> quantities{}; //!< The quantity of every item, in the order of Items. Empty if the slot is not active
+    };
+
+    const std::filesystem::path path;
+    std::vector<u8> mirror; //!< The parts of the save file read so far, at the same offsets as in the file
+    std::vector<Slot> slots;
+    std::array<std::optional<SlotState>, SaveFile::SlotCount> states; //!< Empty until a slot was read for the first time
+    Items::Items items{};
+
+    SaveSpan data() {
+        return SaveSpan{mirror.data(), SaveFileSize};
+    }
+
+    /**
+     * @brief Read the parts of the save file that changed since the last call and print an event for every difference
+     */
+    void refresh();
+
+    /**
+     * @brief Print the differences between what was last reported about a slot and its current state
+     */
+    void report(size_t slotIndex, const std::optional<SlotState> &previous, const SlotState &current) const;
+
+  public:
+    Watcher(std::filesystem::path path);
+
+    /**
+     * @brief Report all active slots, then wait for the game to write the file and report what changed until the process is stopped
+     * @note Waiting uses inotify on the directory of the file, so nothing is read between writes
+     */
+    void run();
+};